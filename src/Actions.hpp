@@ -0,0 +1,134 @@
+#pragma once
+#include "Tako.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// What the keys mean to the game, any number of keys can be bound to each
+enum class Action : uint8_t
+{
+    MoveLeft,
+    MoveRight,
+    MoveUp,
+    MoveDown,
+    Pickup,
+    Use,
+    SkipDay,
+    Start,
+    Count
+};
+
+using ActionBits = uint16_t;
+static_assert((size_t) Action::Count <= sizeof(ActionBits) * 8);
+
+constexpr ActionBits ActionBit(Action action)
+{
+    return ActionBits(1) << (size_t) action;
+}
+
+// One frame of input, small enough to record or send every frame
+struct ActionState
+{
+    ActionBits held = 0;
+    // Went down this frame
+    ActionBits pressed = 0;
+
+    bool Held(Action action) const
+    {
+        return held & ActionBit(action);
+    }
+
+    bool Pressed(Action action) const
+    {
+        return pressed & ActionBit(action);
+    }
+
+    bool AnyPressed() const
+    {
+        return pressed != 0;
+    }
+};
+
+// Rebindable keys, every bound key is polled once per snapshot however many actions share it
+class InputMap
+{
+public:
+    InputMap()
+    {
+        Reset();
+    }
+
+    void Reset()
+    {
+        m_keys.clear();
+        Bind(Action::MoveLeft, {tako::Key::Left, tako::Key::A, tako::Key::Gamepad_Dpad_Left});
+        Bind(Action::MoveRight, {tako::Key::Right, tako::Key::D, tako::Key::Gamepad_Dpad_Right});
+        Bind(Action::MoveUp, {tako::Key::Up, tako::Key::W, tako::Key::Gamepad_Dpad_Up});
+        Bind(Action::MoveDown, {tako::Key::Down, tako::Key::S, tako::Key::Gamepad_Dpad_Down});
+        Bind(Action::Pickup, {tako::Key::L, tako::Key::C, tako::Key::Gamepad_A});
+        Bind(Action::Use, {tako::Key::K, tako::Key::X, tako::Key::Gamepad_B});
+        Bind(Action::SkipDay, {tako::Key::Enter, tako::Key::Gamepad_Start});
+        Bind(Action::Start, {tako::Key::Enter, tako::Key::Gamepad_Start});
+    }
+
+    void Bind(Action action, std::initializer_list<tako::Key> keys)
+    {
+        for (auto key : keys)
+        {
+            Find(key).actions |= ActionBit(action);
+        }
+    }
+
+    void Unbind(Action action, tako::Key key)
+    {
+        Find(key).actions &= ~ActionBit(action);
+        m_keys.erase(std::remove_if(m_keys.begin(), m_keys.end(), [](const Binding& binding) { return binding.actions == 0; }), m_keys.end());
+    }
+
+    // Every key bound to the action goes, it does nothing until bound again
+    void Clear(Action action)
+    {
+        for (auto& binding : m_keys)
+        {
+            binding.actions &= ~ActionBit(action);
+        }
+        m_keys.erase(std::remove_if(m_keys.begin(), m_keys.end(), [](const Binding& binding) { return binding.actions == 0; }), m_keys.end());
+    }
+
+    ActionState Snapshot(tako::Input* input) const
+    {
+        ActionState state;
+        for (auto& binding : m_keys)
+        {
+            if (input->GetKey(binding.key))
+            {
+                state.held |= binding.actions;
+            }
+            if (input->GetKeyDown(binding.key))
+            {
+                state.pressed |= binding.actions;
+            }
+        }
+        return state;
+    }
+private:
+    struct Binding
+    {
+        tako::Key key;
+        ActionBits actions;
+    };
+
+    std::vector<Binding> m_keys;
+
+    Binding& Find(tako::Key key)
+    {
+        for (auto& binding : m_keys)
+        {
+            if (binding.key == key)
+            {
+                return binding;
+            }
+        }
+        return m_keys.emplace_back(Binding{key, 0});
+    }
+};
@@ -0,0 +1,173 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+inline int LowestBit(uint64_t v)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, v);
+    return (int) index;
+#else
+    return __builtin_ctzll(v);
+#endif
+}
+
+// Bits needed to write v, 0 for 0
+inline int BitLength(uint64_t v)
+{
+    if (!v)
+    {
+        return 0;
+    }
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, v);
+    return (int) index + 1;
+#else
+    return 64 - __builtin_clzll(v);
+#endif
+}
+
+// Packs values of any width back to back, least significant bit first
+class BitWriter
+{
+public:
+    void Write(uint32_t value, int bits)
+    {
+        m_acc |= uint64_t(value & Mask(bits)) << m_count;
+        m_count += bits;
+        while (m_count >= 8)
+        {
+            m_bytes.push_back(uint8_t(m_acc));
+            m_acc >>= 8;
+            m_count -= 8;
+        }
+    }
+
+    void WriteBool(bool value)
+    {
+        Write(value, 1);
+    }
+
+    // Elias gamma code of value + 1, small values take few bits: 0 takes 1, up to 2 take 3, up to 6 take 5
+    void WriteVar(uint32_t value)
+    {
+        uint64_t coded = uint64_t(value) + 1;
+        int length = BitLength(coded);
+        Write(0, length - 1);
+        Write(1, 1);
+        // The leading one is implied by the zeros before it
+        WriteWide(coded, length - 1);
+    }
+
+    void WriteSigned(int32_t value)
+    {
+        WriteVar((uint32_t(value) << 1) ^ uint32_t(value >> 31));
+    }
+
+    // Pads the last byte with zeros, the writer is empty again afterwards
+    std::vector<uint8_t> Finish()
+    {
+        if (m_count > 0)
+        {
+            m_bytes.push_back(uint8_t(m_acc));
+        }
+        m_acc = 0;
+        m_count = 0;
+        return std::move(m_bytes);
+    }
+private:
+    std::vector<uint8_t> m_bytes;
+    uint64_t m_acc = 0;
+    int m_count = 0;
+
+    static uint32_t Mask(int bits)
+    {
+        return bits >= 32 ? UINT32_MAX : (1u << bits) - 1;
+    }
+
+    void WriteWide(uint64_t value, int bits)
+    {
+        if (bits > 32)
+        {
+            Write(uint32_t(value), 32);
+            Write(uint32_t(value >> 32), bits - 32);
+        }
+        else
+        {
+            Write(uint32_t(value), bits);
+        }
+    }
+};
+
+// Reads what BitWriter wrote. Reading past the end gives zeros and marks the reader as failed,
+// so a damaged packet is rejected once instead of checked after every field
+class BitReader
+{
+public:
+    BitReader(const uint8_t* data, size_t size) : m_data(data), m_size(size)
+    {
+    }
+
+    uint32_t Read(int bits)
+    {
+        uint32_t value = 0;
+        for (int written = 0; written < bits;)
+        {
+            size_t byte = m_bit / 8;
+            if (byte >= m_size)
+            {
+                m_failed = true;
+                return 0;
+            }
+            int offset = m_bit % 8;
+            int take = std::min(8 - offset, bits - written);
+            value |= uint32_t((m_data[byte] >> offset) & ((1u << take) - 1)) << written;
+            written += take;
+            m_bit += take;
+        }
+        return value;
+    }
+
+    bool ReadBool()
+    {
+        return Read(1);
+    }
+
+    uint32_t ReadVar()
+    {
+        int zeros = 0;
+        while (!Read(1))
+        {
+            if (m_failed || ++zeros > 32)
+            {
+                m_failed = true;
+                return 0;
+            }
+        }
+        uint64_t coded = (uint64_t(1) << zeros) | Read(zeros);
+        return uint32_t(coded - 1);
+    }
+
+    int32_t ReadSigned()
+    {
+        uint32_t value = ReadVar();
+        return int32_t(value >> 1) ^ -int32_t(value & 1);
+    }
+
+    bool Failed() const
+    {
+        return m_failed;
+    }
+private:
+    const uint8_t* m_data;
+    size_t m_size;
+    size_t m_bit = 0;
+    bool m_failed = false;
+};
@@ -0,0 +1,405 @@
+#pragma once
+#include "Crop.hpp"
+#include "Farmhand.hpp"
+#include "Objects.hpp"
+#include "Parallel.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <optional>
+#include <vector>
+
+// Picks the player's next task by playing the rest of the game out many times from a copy of the farm.
+// The copy is coarse: walks cost their tile distance, tasks finish the moment their tile is reached
+// and the farmhands stand still, which keeps a rollout cheap enough to run thousands per decision.
+namespace Bot
+{
+    // Seconds to walk a tile and to face and press a button
+    constexpr float TILE_TIME = 16 / Farmhands::SPEED;
+    constexpr float ACT_TIME = 2 / 60.0f;
+    // Crops, seed bags and soil further away are left to the farmhands
+    constexpr int WINDOW = 24;
+    // A rewound day takes nothing from the score but it does cost a minute of play
+    constexpr float REWIND_COST = 2;
+    // Share of rollout steps that try something other than the obvious
+    constexpr float EXPLORE = 0.1f;
+    // How much better on average another task has to do before the obvious one is dropped for it
+    constexpr float MARGIN = 0.25f;
+    constexpr int ROLLOUTS = 64;
+
+    enum class Goal
+    {
+        Harvest,
+        Water,
+        FetchWater,
+        Deliver,
+        FetchSeeds,
+        Sow,
+        Drop,
+        EndDay,
+        Count
+    };
+
+    struct PlanCrop
+    {
+        TileCoord tile;
+        int stage;
+        // What a rewind puts back
+        int dayStart;
+        bool watered;
+    };
+
+    struct PlanState
+    {
+        std::vector<PlanCrop> crops;
+        std::vector<TileCoord> seedBags;
+        std::vector<TileCoord> soil;
+        std::vector<TileCoord> wells;
+        std::vector<TileCoord> boxes;
+        TileCoord player;
+        TileCoord spawn;
+        ItemType held = ItemType::None;
+        // A held parsnip harvested today is gone when the day is rewound
+        bool heldToday = false;
+        int canLeft = 0;
+        float timeLeft = 0;
+        float dayLength = 60;
+        int day = 1;
+        int parsnips = 0;
+        // Delivered today from today's harvest, taken back by a rewind
+        int parsnipsToday = 0;
+        int rewinds = 0;
+        bool finished = false;
+    };
+
+    struct Random
+    {
+        uint64_t state;
+
+        uint64_t Next()
+        {
+            state += 0x9E3779B97F4A7C15ull;
+            uint64_t v = state;
+            v = (v ^ (v >> 30)) * 0xBF58476D1CE4E5B9ull;
+            v = (v ^ (v >> 27)) * 0x94D049BB133111EBull;
+            return v ^ (v >> 31);
+        }
+
+        float Uniform()
+        {
+            return (Next() >> 40) / float(1 << 24);
+        }
+    };
+
+    inline int Distance(TileCoord a, TileCoord b)
+    {
+        return std::abs(a.first - b.first) + std::abs(a.second - b.second);
+    }
+
+    template<class T, class F>
+    std::optional<size_t> Nearest(const std::vector<T>& items, TileCoord from, F tileOf)
+    {
+        std::optional<size_t> nearest;
+        int best = 0;
+        for (size_t i = 0; i < items.size(); i++)
+        {
+            auto tile = tileOf(items[i]);
+            if (!tile)
+            {
+                continue;
+            }
+            int distance = Distance(*tile, from);
+            if (!nearest || distance < best)
+            {
+                best = distance;
+                nearest = i;
+            }
+        }
+        return nearest;
+    }
+
+    inline std::optional<size_t> NearestTile(const std::vector<TileCoord>& tiles, TileCoord from)
+    {
+        return Nearest(tiles, from, [](TileCoord tile) { return std::optional<TileCoord>(tile); });
+    }
+
+    inline std::optional<size_t> NearestCrop(const PlanState& state, bool ripe)
+    {
+        return Nearest(state.crops, state.player, [&](const PlanCrop& crop)
+        {
+            bool wanted = ripe ? crop.stage == 4 : crop.stage > 0 && !crop.watered;
+            return wanted ? std::optional<TileCoord>(crop.tile) : std::nullopt;
+        });
+    }
+
+    inline Goal Obvious(const PlanState& state);
+
+    inline bool Feasible(const PlanState& state, Goal goal)
+    {
+        switch (goal)
+        {
+            case Goal::Harvest:
+                return state.held == ItemType::None && NearestCrop(state, true);
+            case Goal::Water:
+                return state.held == ItemType::WateringCan && NearestCrop(state, false);
+            case Goal::FetchWater:
+                return (state.held == ItemType::None || (state.held == ItemType::WateringCan && state.canLeft < WateringCan().left)) && !state.wells.empty();
+            case Goal::Deliver:
+                return state.held == ItemType::Parsnip && !state.boxes.empty();
+            case Goal::FetchSeeds:
+                return state.held == ItemType::None && !state.seedBags.empty();
+            case Goal::Sow:
+                return state.held == ItemType::SeedBag && !state.soil.empty();
+            case Goal::Drop:
+                // Putting down what the next task needs only costs the time to pick it up again
+                return state.held != ItemType::None && Obvious(state) == Goal::Drop;
+            default:
+                return true;
+        }
+    }
+
+    // Crops grow when all of them were watered, otherwise the day starts over, like Game::SimulateDay
+    inline void EndDay(PlanState& state)
+    {
+        bool allWatered = std::all_of(state.crops.begin(), state.crops.end(), [](const PlanCrop& crop)
+        {
+            return crop.stage <= 0 || crop.watered;
+        });
+        if (allWatered)
+        {
+            if (state.day == TOTAL_DAYS)
+            {
+                state.finished = true;
+                return;
+            }
+            state.day++;
+            state.parsnipsToday = 0;
+            state.heldToday = false;
+        }
+        else
+        {
+            state.rewinds++;
+            state.parsnips -= state.parsnipsToday;
+            state.parsnipsToday = 0;
+            if (state.heldToday)
+            {
+                state.held = ItemType::None;
+                state.heldToday = false;
+            }
+        }
+        for (auto& crop : state.crops)
+        {
+            crop.stage = allWatered ? (crop.stage > 0 ? std::min(crop.stage + 1, 4) : 0) : crop.dayStart;
+            crop.dayStart = crop.stage;
+            crop.watered = false;
+            if (crop.stage <= 0)
+            {
+                state.soil.push_back(crop.tile);
+            }
+        }
+        state.crops.erase(std::remove_if(state.crops.begin(), state.crops.end(), [](const PlanCrop& crop)
+        {
+            return crop.stage <= 0;
+        }), state.crops.end());
+        state.player = state.spawn;
+        state.timeLeft = state.dayLength;
+    }
+
+    // Walks to the goal's nearest tile and does it, the day ends first when there is no time left for it
+    inline void Apply(PlanState& state, Goal goal)
+    {
+        std::optional<size_t> index;
+        TileCoord tile = state.player;
+        switch (goal)
+        {
+            case Goal::Harvest:
+            case Goal::Water:
+                index = NearestCrop(state, goal == Goal::Harvest);
+                tile = state.crops[index.value()].tile;
+                break;
+            case Goal::FetchWater:
+                tile = state.wells[NearestTile(state.wells, state.player).value()];
+                break;
+            case Goal::Deliver:
+                tile = state.boxes[NearestTile(state.boxes, state.player).value()];
+                break;
+            case Goal::FetchSeeds:
+                index = NearestTile(state.seedBags, state.player);
+                tile = state.seedBags[index.value()];
+                break;
+            case Goal::Sow:
+                index = NearestTile(state.soil, state.player);
+                tile = state.soil[index.value()];
+                break;
+            default:
+                break;
+        }
+
+        float cost = Distance(tile, state.player) * TILE_TIME + ACT_TIME;
+        if (goal == Goal::EndDay || cost >= state.timeLeft)
+        {
+            EndDay(state);
+            return;
+        }
+        state.timeLeft -= cost;
+        state.player = tile;
+        switch (goal)
+        {
+            case Goal::Harvest:
+            {
+                auto& crop = state.crops[index.value()];
+                crop.stage = 0;
+                crop.watered = true;
+                state.held = ItemType::Parsnip;
+                state.heldToday = true;
+                break;
+            }
+            case Goal::Water:
+                state.crops[index.value()].watered = true;
+                if (--state.canLeft <= 0)
+                {
+                    state.held = ItemType::None;
+                }
+                break;
+            case Goal::FetchWater:
+                state.held = ItemType::WateringCan;
+                state.canLeft = WateringCan().left;
+                break;
+            case Goal::Deliver:
+                state.parsnips++;
+                state.parsnipsToday += state.heldToday;
+                state.held = ItemType::None;
+                state.heldToday = false;
+                break;
+            case Goal::FetchSeeds:
+                state.seedBags.erase(state.seedBags.begin() + index.value());
+                state.held = ItemType::SeedBag;
+                break;
+            case Goal::Sow:
+                state.crops.push_back({tile, 1, 0, false});
+                state.soil.erase(state.soil.begin() + index.value());
+                break;
+            case Goal::Drop:
+                if (state.held == ItemType::SeedBag)
+                {
+                    state.seedBags.push_back(state.player);
+                }
+                state.held = ItemType::None;
+                state.heldToday = false;
+                break;
+            default:
+                break;
+        }
+    }
+
+    // What a sensible player does next: water first, a day with a dry crop is lost, then harvest and sow
+    inline Goal Obvious(const PlanState& state)
+    {
+        bool ripe = NearestCrop(state, true).has_value();
+        bool dry = NearestCrop(state, false).has_value();
+        switch (state.held)
+        {
+            case ItemType::Parsnip:
+                return Feasible(state, Goal::Deliver) ? Goal::Deliver : Goal::Drop;
+            case ItemType::WateringCan:
+                return dry ? Goal::Water : ripe ? Goal::Drop : Goal::EndDay;
+            case ItemType::SeedBag:
+                return dry || ripe ? Goal::Drop : !state.soil.empty() ? Goal::Sow : Goal::EndDay;
+            default:
+                if (dry && !state.wells.empty())
+                {
+                    return Goal::FetchWater;
+                }
+                if (ripe)
+                {
+                    return Goal::Harvest;
+                }
+                return Feasible(state, Goal::FetchSeeds) && !state.soil.empty() ? Goal::FetchSeeds : Goal::EndDay;
+        }
+    }
+
+    // The rollout policy: mostly the obvious, sometimes any other task that is possible.
+    // Ending the day is never explored, it would cut most rollouts short.
+    inline Goal Pick(const PlanState& state, Random& random)
+    {
+        if (random.Uniform() < EXPLORE)
+        {
+            std::array<Goal, (size_t) Goal::Count> options;
+            size_t count = 0;
+            for (int i = 0; i < (int) Goal::EndDay; i++)
+            {
+                if (Feasible(state, (Goal) i))
+                {
+                    options[count++] = (Goal) i;
+                }
+            }
+            if (count > 0)
+            {
+                return options[random.Next() % count];
+            }
+        }
+        return Obvious(state);
+    }
+
+    inline float Rollout(PlanState& state, Goal first, Random& random)
+    {
+        // Enough for every day to be rewound once on average, a policy that never waters still stops
+        constexpr int MAX_DAYS = TOTAL_DAYS * 2;
+        Apply(state, first);
+        while (!state.finished && state.day - 1 + state.rewinds < MAX_DAYS)
+        {
+            Apply(state, Pick(state, random));
+        }
+        return state.parsnips - state.rewinds * REWIND_COST;
+    }
+
+    // The first goal with the best average outcome over its rollouts, run on every core.
+    // The same state and seed give the same choice whatever the number of threads.
+    inline Goal Choose(const PlanState& state, int rollouts, uint64_t seed)
+    {
+        std::vector<Goal> candidates;
+        for (int i = 0; i < (int) Goal::Count; i++)
+        {
+            if (Feasible(state, (Goal) i))
+            {
+                candidates.push_back((Goal) i);
+            }
+        }
+        if (candidates.size() == 1)
+        {
+            return candidates[0];
+        }
+
+        std::vector<float> scores(candidates.size() * rollouts);
+        Parallel::For(scores.size(), 4, [&](int begin, int end)
+        {
+            for (int i = begin; i < end; i++)
+            {
+                // Every candidate sees the same futures, so their scores differ by the choice and not by luck
+                Random random = {seed ^ (uint64_t(i % rollouts) << 32)};
+                PlanState copy = state;
+                scores[i] = Rollout(copy, candidates[i / rollouts], random);
+            }
+        });
+
+        auto obvious = Obvious(state);
+        auto best = obvious;
+        float bestScore = 0;
+        for (size_t c = 0; c < candidates.size(); c++)
+        {
+            float score = 0;
+            for (int r = 0; r < rollouts; r++)
+            {
+                score += scores[c * rollouts + r];
+            }
+            score = score / rollouts + (candidates[c] == obvious ? MARGIN : 0);
+            if (c == 0 || score > bestScore)
+            {
+                best = candidates[c];
+                bestScore = score;
+            }
+        }
+        return best;
+    }
+}
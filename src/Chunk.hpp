@@ -0,0 +1,116 @@
+#pragma once
+#include "Bits.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+constexpr int CHUNK_SIZE = 64;
+
+struct BuildingSize
+{
+    int startIndex;
+    int x;
+    int y;
+
+    BuildingSize(int s, int x, int y)
+    {
+        startIndex = s;
+        this->x = x;
+        this->y = y;
+    }
+};
+
+const std::map<char, BuildingSize> BUILDING_INFO =
+{{
+    {'W', {13, 2, 2}},
+    {'B', {17, 2, 2}}
+}};
+
+// One byte, the tileset has less than 128 tiles
+struct Tile
+{
+    uint8_t index : 7;
+    uint8_t solid : 1;
+
+    Tile() : index(0), solid(false) {}
+
+    bool operator==(const Tile& other) const
+    {
+        return index == other.index && solid == other.solid;
+    }
+};
+static_assert(sizeof(Tile) == 1);
+
+// Inclusive range of tile coordinates
+struct TileArea
+{
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+};
+
+// Something placed on the level when its chunk loads, state is empty unless it comes back from an evicted chunk
+struct Spawn
+{
+    char type;
+    int x;
+    int y;
+    std::vector<int> state;
+
+    bool operator==(const Spawn& other) const
+    {
+        return type == other.type && x == other.x && y == other.y && state == other.state;
+    }
+
+    bool operator<(const Spawn& other) const
+    {
+        return std::tie(y, x, type, state) < std::tie(other.y, other.x, other.type, other.state);
+    }
+};
+
+// Interleaves the bits of x and y, tiles close in 2D stay close in memory whichever way a grid is walked
+inline int Morton(int x, int y)
+{
+    auto spread = [](uint32_t v)
+    {
+        v = (v | (v << 8)) & 0x00FF00FF;
+        v = (v | (v << 4)) & 0x0F0F0F0F;
+        v = (v | (v << 2)) & 0x33333333;
+        v = (v | (v << 1)) & 0x55555555;
+        return v;
+    };
+    return (int) (spread(x) | (spread(y) << 1));
+}
+
+// CHUNK_SIZE x CHUNK_SIZE tiles in Morton order, with one solid bit per tile so a chunk row is one word
+struct Chunk
+{
+    int x;
+    int y;
+    std::array<Tile, CHUNK_SIZE * CHUNK_SIZE> tiles;
+    std::array<uint64_t, CHUNK_SIZE> solid = {};
+    // Sorted by whoever fills them, so two chunks holding the same things compare equal
+    std::vector<Spawn> spawns;
+
+    Tile& At(int localX, int localY)
+    {
+        return tiles[Morton(localX, localY)];
+    }
+
+    void SetSolid(int localX, int localY, bool value)
+    {
+        uint64_t bit = uint64_t(1) << localX;
+        solid[localY] = value ? solid[localY] | bit : solid[localY] & ~bit;
+        At(localX, localY).solid = value;
+    }
+
+    bool SameContent(const Chunk& other) const
+    {
+        return tiles == other.tiles && spawns == other.spawns;
+    }
+};
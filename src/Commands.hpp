@@ -0,0 +1,30 @@
+#pragma once
+#include "World.hpp"
+#include <algorithm>
+#include <vector>
+
+// Deletes recorded during a phase and applied together at its sync point, so nothing leaves an archetype while
+// a phase is still iterating. Nothing in the game adds or removes components, items change state instead, and
+// creations stay immediate since their callers use the new entity right away
+class CommandBuffer
+{
+public:
+    void Delete(tako::Entity entity)
+    {
+        m_deletes.push_back(entity);
+    }
+
+    void Apply(tako::World& world)
+    {
+        // An entity recorded twice is deleted once
+        std::sort(m_deletes.begin(), m_deletes.end());
+        m_deletes.erase(std::unique(m_deletes.begin(), m_deletes.end()), m_deletes.end());
+        for (auto entity : m_deletes)
+        {
+            world.Delete(entity);
+        }
+        m_deletes.clear();
+    }
+private:
+    std::vector<tako::Entity> m_deletes;
+};
@@ -0,0 +1,66 @@
+#pragma once
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+enum class EventType
+{
+    Pickup,
+    Drop,
+    Harvest,
+    Deliver,
+    Sow,
+    Water,
+    Fill,
+    Error,
+    DayPassed,
+    DayRewound,
+    ClockChanged,
+    Count
+};
+
+struct Event
+{
+    EventType type;
+    // Farmhands' events still count for the HUD but make no sound
+    bool audible = true;
+    int value = 0;
+};
+
+// Gameplay events of a frame, every consumer gets them as one batch once the frame is done
+class EventQueue
+{
+public:
+    using Consumer = std::function<void(const std::vector<Event>&)>;
+
+    void Subscribe(Consumer consumer)
+    {
+        m_consumers.push_back(std::move(consumer));
+    }
+
+    // Any job of the frame may push
+    void Push(Event event)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_events.push_back(event);
+    }
+
+    void Dispatch()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            std::swap(m_events, m_batch);
+        }
+        for (auto& consumer : m_consumers)
+        {
+            consumer(m_batch);
+        }
+        m_batch.clear();
+    }
+private:
+    std::mutex m_mutex;
+    std::vector<Event> m_events;
+    std::vector<Event> m_batch;
+    std::vector<Consumer> m_consumers;
+};
@@ -0,0 +1,179 @@
+#pragma once
+#include "Chunk.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+// Seeded farm of any size, every chunk can be generated on its own and in any order.
+// The world is split into square plots with grass paths between them, a plot is a crop field,
+// a yard with a well, a transport box, tools and farmhands, or left as meadow.
+class FarmGenerator
+{
+public:
+    static constexpr int PLOT_SIZE = 32;
+
+    FarmGenerator(int width, int height, uint64_t seed) : m_width(width), m_height(height), m_seed(seed) {}
+
+    int Width() const
+    {
+        return m_width;
+    }
+
+    int Height() const
+    {
+        return m_height;
+    }
+
+    std::pair<int, int> PlayerSpawn() const
+    {
+        auto [px, py] = CenterPlot();
+        return {px * PLOT_SIZE + PLOT_SIZE / 2, py * PLOT_SIZE + PLOT_SIZE / 2};
+    }
+
+    void Generate(int chunkX, int chunkY, Chunk& chunk) const
+    {
+        chunk.x = chunkX;
+        chunk.y = chunkY;
+        chunk.tiles.fill(Tile());
+        chunk.solid.fill(0);
+        chunk.spawns.clear();
+        for (int ly = 0; ly < CHUNK_SIZE; ly++)
+        {
+            for (int lx = 0; lx < CHUNK_SIZE; lx++)
+            {
+                int x = chunkX * CHUNK_SIZE + lx;
+                int y = chunkY * CHUNK_SIZE + ly;
+                if (x >= m_width || y > m_height)
+                {
+                    continue;
+                }
+                GenerateTile(x, y, chunk);
+            }
+        }
+        std::sort(chunk.spawns.begin(), chunk.spawns.end());
+    }
+private:
+    enum class Plot
+    {
+        Meadow,
+        Field,
+        Yard
+    };
+
+    int m_width;
+    int m_height;
+    uint64_t m_seed;
+
+    static uint64_t Mix(uint64_t v)
+    {
+        v += 0x9E3779B97F4A7C15ull;
+        v = (v ^ (v >> 30)) * 0xBF58476D1CE4E5B9ull;
+        v = (v ^ (v >> 27)) * 0x94D049BB133111EBull;
+        return v ^ (v >> 31);
+    }
+
+    uint64_t Hash(int x, int y, int salt) const
+    {
+        return Mix(m_seed ^ Mix((uint64_t(uint32_t(x)) << 32 | uint32_t(y)) ^ Mix(salt)));
+    }
+
+    std::pair<int, int> CenterPlot() const
+    {
+        return {m_width / 2 / PLOT_SIZE, m_height / 2 / PLOT_SIZE};
+    }
+
+    Plot PlotKind(int px, int py) const
+    {
+        if (std::make_pair(px, py) == CenterPlot())
+        {
+            return Plot::Yard;
+        }
+        // Plots cut off by the map edge would have no room for buildings
+        if ((px + 1) * PLOT_SIZE > m_width || (py + 1) * PLOT_SIZE > m_height)
+        {
+            return Plot::Meadow;
+        }
+        auto roll = Hash(px, py, 0) % 8;
+        return roll == 0 ? Plot::Yard : roll < 6 ? Plot::Field : Plot::Meadow;
+    }
+
+    void GenerateTile(int x, int y, Chunk& chunk) const
+    {
+        int lx = x - chunk.x * CHUNK_SIZE;
+        int ly = y - chunk.y * CHUNK_SIZE;
+        int px = x / PLOT_SIZE;
+        int py = y / PLOT_SIZE;
+        int ox = x % PLOT_SIZE;
+        int oy = y % PLOT_SIZE;
+        Tile& tile = chunk.At(lx, ly);
+        tile.index = 11;
+        if (ox == 0 || oy == 0)
+        {
+            return;
+        }
+
+        switch (PlotKind(px, py))
+        {
+            case Plot::Meadow:
+                break;
+            case Plot::Field:
+                if (ox >= 3 && ox < PLOT_SIZE - 2 && oy >= 3 && oy < PLOT_SIZE - 2)
+                {
+                    tile.index = 1;
+                    // Beds of crops with walkable rows in between
+                    if (oy % 3 != 0 && Hash(x, y, 1) % 4 != 0)
+                    {
+                        tile.index = 3;
+                        chunk.spawns.push_back({'C', x, y, {}});
+                    }
+                }
+                break;
+            case Plot::Yard:
+                GenerateYardTile(x, y, ox, oy, chunk);
+                break;
+        }
+    }
+
+    void GenerateYardTile(int x, int y, int ox, int oy, Chunk& chunk) const
+    {
+        // Buildings hang down from their top left tile like in level files
+        auto building = [&](char type, int left, int top)
+        {
+            auto& info = BUILDING_INFO.at(type);
+            int bx = ox - left;
+            int by = top - oy;
+            if (bx < 0 || bx >= info.x || by < 0 || by >= info.y)
+            {
+                return false;
+            }
+            chunk.At(x - chunk.x * CHUNK_SIZE, y - chunk.y * CHUNK_SIZE).index = info.startIndex + bx + by * info.x;
+            chunk.SetSolid(x - chunk.x * CHUNK_SIZE, y - chunk.y * CHUNK_SIZE, true);
+            if (bx == 0 && by == 0)
+            {
+                chunk.spawns.push_back({type, x, y, {}});
+            }
+            return true;
+        };
+        if (building('W', 4, 26) || building('B', 10, 26))
+        {
+            return;
+        }
+
+        if (ox == 7 && oy == 24)
+        {
+            chunk.spawns.push_back({'w', x, y, {}});
+        }
+        else if (ox == 14 && oy == 24)
+        {
+            chunk.spawns.push_back({'b', x, y, {}});
+        }
+        else if (oy == 20 && ox >= 4 && ox < 12 && ox % 2 == 0)
+        {
+            chunk.spawns.push_back({'F', x, y, {}});
+        }
+        else if (std::make_pair(x / PLOT_SIZE, y / PLOT_SIZE) == CenterPlot() && ox == PLOT_SIZE / 2 && oy == PLOT_SIZE / 2)
+        {
+            chunk.spawns.push_back({'S', x, y, {}});
+        }
+    }
+};
@@ -0,0 +1,234 @@
+#pragma once
+#include "Tako.hpp"
+#include "World.hpp"
+#include "Level.hpp"
+#include "Rect.hpp"
+#include "FlowField.hpp"
+#include <array>
+#include <cstdlib>
+#include <optional>
+#include <set>
+#include <utility>
+#include <vector>
+
+enum class FarmhandTask
+{
+    Idle,
+    FetchWater,
+    Water,
+    Harvest,
+    Deliver,
+    FetchSeeds,
+    Sow,
+    Drop,
+    Rest
+};
+
+struct Farmhand
+{
+    tako::Vector2 facing;
+    std::optional<tako::Entity> heldObject;
+    bool wasMoving;
+    tako::Vector2 home;
+    FarmhandTask task;
+    int standX;
+    int standY;
+    tako::Vector2 workFacing;
+    int targetX;
+    int targetY;
+    float patience;
+    float sidestep;
+    bool sidestepLeft;
+    tako::Vector2 proposed;
+};
+
+using TileCoord = std::pair<int, int>;
+
+// Everything farmhands can work on this frame, gathered once before planning
+struct FarmTargets
+{
+    std::vector<TileCoord> unwatered;
+    std::vector<TileCoord> ripe;
+    std::vector<TileCoord> seedBags;
+    std::set<TileCoord> occupied;
+    std::set<TileCoord> reserved;
+};
+
+namespace Farmhands
+{
+    constexpr float SPEED = 30;
+    constexpr float PATIENCE = 8;
+    constexpr float SIDESTEP = 0.4f;
+    constexpr int SOW_RADIUS = 12;
+
+    TileCoord TileOf(tako::Vector2 pos)
+    {
+        return {((int) pos.x) / 16, ((int) pos.y) / 16};
+    }
+
+    std::vector<TileCoord> TilesCovered(Rect rect)
+    {
+        std::vector<TileCoord> tiles;
+        for (int y = (int) rect.Bottom() / 16; y < (int) rect.Top() / 16; y++)
+        {
+            for (int x = (int) rect.Left() / 16; x < (int) rect.Right() / 16; x++)
+            {
+                tiles.emplace_back(x, y);
+            }
+        }
+        return tiles;
+    }
+
+    // Picks the walkable tile next to one of cells that is closest to pos and points the farmhand at it
+    bool AssignStand(Level& level, const FarmTargets& targets, const std::vector<TileCoord>& cells, tako::Vector2 pos, Farmhand& hand)
+    {
+        constexpr std::array<TileCoord, 4> sides = {{{1, 0}, {-1, 0}, {0, 1}, {0, -1}}};
+        float best = -1;
+        for (auto [cx, cy] : cells)
+        {
+            for (auto [dx, dy] : sides)
+            {
+                TileCoord stand = {cx + dx, cy + dy};
+                if (level.IsSolid(stand.first, stand.second) || targets.occupied.count(stand))
+                {
+                    continue;
+                }
+                bool inside = false;
+                for (auto& cell : cells)
+                {
+                    inside |= cell == stand;
+                }
+                if (inside)
+                {
+                    continue;
+                }
+
+                tako::Vector2 center(stand.first * 16 + 8, stand.second * 16 + 8);
+                float distance = (center - pos).magnitude();
+                if (best < 0 || distance < best)
+                {
+                    best = distance;
+                    hand.standX = stand.first;
+                    hand.standY = stand.second;
+                    hand.targetX = cx;
+                    hand.targetY = cy;
+                    hand.workFacing = tako::Vector2(-dx, -dy);
+                }
+            }
+        }
+
+        return best >= 0;
+    }
+
+    std::optional<size_t> Nearest(const std::vector<TileCoord>& tiles, const std::set<TileCoord>& reserved, tako::Vector2 pos)
+    {
+        std::optional<size_t> nearest;
+        float best = 0;
+        for (size_t i = 0; i < tiles.size(); i++)
+        {
+            if (reserved.count(tiles[i]))
+            {
+                continue;
+            }
+            tako::Vector2 center(tiles[i].first * 16 + 8, tiles[i].second * 16 + 8);
+            float distance = (center - pos).magnitude();
+            if (!nearest || distance < best)
+            {
+                best = distance;
+                nearest = i;
+            }
+        }
+        return nearest;
+    }
+
+    // Closest dirt tile without a crop or item on it, searched in growing rings around the farmhand
+    std::optional<TileCoord> FindSowTile(Level& level, const FarmTargets& targets, tako::Vector2 pos)
+    {
+        auto [px, py] = TileOf(pos);
+        for (int r = 0; r <= SOW_RADIUS; r++)
+        {
+            for (int y = py - r; y <= py + r; y++)
+            {
+                for (int x = px - r; x <= px + r; x++)
+                {
+                    if (std::max(std::abs(x - px), std::abs(y - py)) != r)
+                    {
+                        continue;
+                    }
+                    auto tile = level.GetTile(x, y);
+                    if (!tile || (tile.value()->index != 1 && tile.value()->index != 2))
+                    {
+                        continue;
+                    }
+                    if (targets.occupied.count({x, y}) || targets.reserved.count({x, y}))
+                    {
+                        continue;
+                    }
+                    return TileCoord(x, y);
+                }
+            }
+        }
+        return std::nullopt;
+    }
+
+    // The tile to head for next, following the field when the task has one
+    tako::Vector2 Waypoint(tako::Vector2 pos, const Farmhand& hand, const FlowField* field)
+    {
+        if (!field)
+        {
+            return tako::Vector2(hand.standX * 16 + 8, hand.standY * 16 + 8);
+        }
+        auto [x, y] = TileOf(pos);
+        auto next = field->Distance(x, y) == 1 ? std::nullopt : field->Next(x, y);
+        if (!next)
+        {
+            return tako::Vector2(x * 16 + 8, y * 16 + 8);
+        }
+        return tako::Vector2(next->first * 16 + 8, next->second * 16 + 8);
+    }
+
+    // Towards the next waypoint, or around whatever blocked the way last time
+    tako::Vector2 Steer(tako::Vector2 pos, const Farmhand& hand, const FlowField* field, float dt)
+    {
+        auto delta = Waypoint(pos, hand, field) - pos;
+        float distance = delta.magnitude();
+        float step = SPEED * dt;
+        if (hand.sidestep > 0 && distance > 0)
+        {
+            auto direction = delta / distance;
+            return hand.sidestepLeft ? tako::Vector2(-direction.y, direction.x) * step : tako::Vector2(direction.y, -direction.x) * step;
+        }
+        if (distance <= step)
+        {
+            return delta;
+        }
+        return delta / distance * step;
+    }
+
+    bool Arrived(tako::Vector2 pos, const Farmhand& hand, const FlowField* field)
+    {
+        if (field)
+        {
+            auto [x, y] = TileOf(pos);
+            tako::Vector2 center(x * 16 + 8, y * 16 + 8);
+            return field->Distance(x, y) == 1 && (center - pos).magnitude() < 0.5f;
+        }
+        tako::Vector2 stand(hand.standX * 16 + 8, hand.standY * 16 + 8);
+        return (stand - pos).magnitude() < 0.5f;
+    }
+
+    // Points the farmhand at the target next to its tile
+    void FaceTarget(tako::Vector2 pos, Farmhand& hand, const FlowField& field)
+    {
+        auto [x, y] = TileOf(pos);
+        constexpr std::array<TileCoord, 4> sides = {{{1, 0}, {-1, 0}, {0, 1}, {0, -1}}};
+        for (auto [dx, dy] : sides)
+        {
+            if (field.IsTarget(x + dx, y + dy))
+            {
+                hand.workFacing = tako::Vector2(dx, dy);
+                return;
+            }
+        }
+    }
+}
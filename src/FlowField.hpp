@@ -0,0 +1,318 @@
+#pragma once
+#include "Level.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Steps to the nearest target for every tile, shared by everyone walking to the same kind of target.
+// Targets count as reached from any walkable tile next to them, so solid buildings work as targets.
+// Adding or removing targets and changing tiles only recomputes the tiles whose distance changes.
+// The field covers whole chunks of the level, tiles anywhere else are unreachable. Each chunk gets a block
+// of CHUNK_SIZE rows, so players far apart cost their own chunks rather than everything between them.
+class FlowField
+{
+public:
+    static constexpr int UNREACHABLE = std::numeric_limits<int>::max();
+
+    void Init(Level* level, const std::vector<std::pair<int, int>>& chunks)
+    {
+        m_level = level;
+        m_blocks.clear();
+        m_blockX.clear();
+        m_blockY.clear();
+        for (auto [chunkX, chunkY] : chunks)
+        {
+            m_blocks[Key(chunkX, chunkY)] = m_blockX.size();
+            m_blockX.push_back(chunkX * CHUNK_SIZE);
+            m_blockY.push_back(chunkY * CHUNK_SIZE);
+        }
+        size_t tiles = chunks.size() * BLOCK_TILES;
+        m_distance.assign(tiles, UNREACHABLE);
+        m_targets.assign(tiles, 0);
+        m_affected.assign(tiles, 0);
+    }
+
+    void SetTargets(const std::vector<std::pair<int, int>>& targets)
+    {
+        std::fill(m_distance.begin(), m_distance.end(), UNREACHABLE);
+        std::fill(m_targets.begin(), m_targets.end(), 0);
+        Open open;
+        for (auto [x, y] : targets)
+        {
+            int i = Index(x, y);
+            if (i < 0)
+            {
+                continue;
+            }
+            m_targets[i]++;
+            m_distance[i] = 0;
+            open.push({0, i});
+        }
+        Relax(open);
+    }
+
+    void AddTarget(int x, int y)
+    {
+        int i = Index(x, y);
+        if (i < 0 || m_targets[i]++ > 0)
+        {
+            return;
+        }
+        m_distance[i] = 0;
+        Open open;
+        open.push({0, i});
+        Relax(open);
+    }
+
+    void RemoveTarget(int x, int y)
+    {
+        int i = Index(x, y);
+        if (i < 0 || m_targets[i] == 0 || --m_targets[i] > 0)
+        {
+            return;
+        }
+        Raise(i);
+    }
+
+    // Call after the tile's solidity changed
+    void TileChanged(int x, int y)
+    {
+        int i = Index(x, y);
+        if (i < 0)
+        {
+            return;
+        }
+        if (m_targets[i])
+        {
+            // Targets stay seeds either way, only their neighbours can get new routes
+            Open open;
+            open.push({0, i});
+            Relax(open);
+            return;
+        }
+        if (!Passable(i))
+        {
+            if (m_distance[i] != UNREACHABLE)
+            {
+                Raise(i);
+            }
+            return;
+        }
+
+        int best = BestNeighbour(i);
+        if (best != UNREACHABLE && best + 1 < m_distance[i])
+        {
+            m_distance[i] = best + 1;
+            Open open;
+            open.push({m_distance[i], i});
+            Relax(open);
+        }
+    }
+
+    int Distance(int x, int y) const
+    {
+        int i = Index(x, y);
+        return i < 0 ? UNREACHABLE : m_distance[i];
+    }
+
+    bool IsTarget(int x, int y) const
+    {
+        int i = Index(x, y);
+        return i >= 0 && m_targets[i] > 0;
+    }
+
+    // The neighbour one step closer to a target, or a walkable neighbour to step onto when standing on one
+    std::optional<std::pair<int, int>> Next(int x, int y) const
+    {
+        int distance = Distance(x, y);
+        if (distance == UNREACHABLE)
+        {
+            return std::nullopt;
+        }
+        std::optional<std::pair<int, int>> next;
+        for (auto [dx, dy] : SIDES)
+        {
+            int nx = x + dx;
+            int ny = y + dy;
+            int d = Distance(nx, ny);
+            if (d == UNREACHABLE)
+            {
+                continue;
+            }
+            if (distance == 0 ? d == 1 && Passable(Index(nx, ny)) : d == distance - 1)
+            {
+                next = std::make_pair(nx, ny);
+                break;
+            }
+        }
+        return next;
+    }
+private:
+    using Open = std::priority_queue<std::pair<int, int>, std::vector<std::pair<int, int>>, std::greater<std::pair<int, int>>>;
+
+    static constexpr std::array<std::pair<int, int>, 4> SIDES = {{{1, 0}, {-1, 0}, {0, 1}, {0, -1}}};
+
+    static constexpr int BLOCK_TILES = CHUNK_SIZE * CHUNK_SIZE;
+
+    Level* m_level = nullptr;
+    // Block of every covered chunk, and the tile its corner is at
+    std::unordered_map<uint64_t, int> m_blocks;
+    std::vector<int> m_blockX;
+    std::vector<int> m_blockY;
+    std::vector<int> m_distance;
+    std::vector<uint16_t> m_targets;
+    std::vector<uint8_t> m_affected;
+
+    static uint64_t Key(int chunkX, int chunkY)
+    {
+        return uint64_t(uint32_t(chunkY)) << 32 | uint32_t(chunkX);
+    }
+
+    // -1 outside the covered chunks
+    int Index(int x, int y) const
+    {
+        if (x < 0 || y < 0)
+        {
+            return -1;
+        }
+        auto block = m_blocks.find(Key(x / CHUNK_SIZE, y / CHUNK_SIZE));
+        if (block == m_blocks.end())
+        {
+            return -1;
+        }
+        return block->second * BLOCK_TILES + (y % CHUNK_SIZE) * CHUNK_SIZE + x % CHUNK_SIZE;
+    }
+
+    int TileX(int i) const
+    {
+        return m_blockX[i / BLOCK_TILES] + i % CHUNK_SIZE;
+    }
+
+    int TileY(int i) const
+    {
+        return m_blockY[i / BLOCK_TILES] + i % BLOCK_TILES / CHUNK_SIZE;
+    }
+
+    bool Passable(int i) const
+    {
+        return !m_level->IsSolid(TileX(i), TileY(i));
+    }
+
+    // Neighbours in the same chunk are found without a lookup
+    template<class F>
+    void ForNeighbours(int i, F&& fn) const
+    {
+        int localX = i % CHUNK_SIZE;
+        int localY = i % BLOCK_TILES / CHUNK_SIZE;
+        for (auto [dx, dy] : SIDES)
+        {
+            int nx = localX + dx;
+            int ny = localY + dy;
+            if (nx >= 0 && nx < CHUNK_SIZE && ny >= 0 && ny < CHUNK_SIZE)
+            {
+                fn(i + dx + dy * CHUNK_SIZE);
+                continue;
+            }
+            int n = Index(TileX(i) + dx, TileY(i) + dy);
+            if (n >= 0)
+            {
+                fn(n);
+            }
+        }
+    }
+
+    int BestNeighbour(int i) const
+    {
+        int best = UNREACHABLE;
+        ForNeighbours(i, [&](int n)
+        {
+            if (!m_affected[n])
+            {
+                best = std::min(best, m_distance[n]);
+            }
+        });
+        return best;
+    }
+
+    // Dijkstra from the open tiles, only ever lowers distances
+    void Relax(Open& open)
+    {
+        while (!open.empty())
+        {
+            auto [distance, i] = open.top();
+            open.pop();
+            if (distance > m_distance[i])
+            {
+                continue;
+            }
+            ForNeighbours(i, [&](int n)
+            {
+                if (distance + 1 < m_distance[n] && Passable(n) && !m_targets[n])
+                {
+                    m_distance[n] = distance + 1;
+                    open.push({distance + 1, n});
+                }
+            });
+        }
+    }
+
+    // The tile lost its route, invalidate everything that only routed through it and fill that region back in from its edge
+    void Raise(int start)
+    {
+        std::vector<int> affected = {start};
+        m_affected[start] = 1;
+        for (size_t head = 0; head < affected.size(); head++)
+        {
+            int c = affected[head];
+            ForNeighbours(c, [&](int n)
+            {
+                if (m_affected[n] || m_targets[n] || m_distance[n] != m_distance[c] + 1)
+                {
+                    return;
+                }
+                bool supported = false;
+                ForNeighbours(n, [&](int m)
+                {
+                    supported |= !m_affected[m] && m_distance[m] == m_distance[n] - 1;
+                });
+                if (!supported)
+                {
+                    m_affected[n] = 1;
+                    affected.push_back(n);
+                }
+            });
+        }
+
+        for (int i : affected)
+        {
+            m_distance[i] = UNREACHABLE;
+        }
+        Open open;
+        for (int i : affected)
+        {
+            if (!Passable(i))
+            {
+                continue;
+            }
+            int best = BestNeighbour(i);
+            if (best != UNREACHABLE)
+            {
+                m_distance[i] = best + 1;
+                open.push({best + 1, i});
+            }
+        }
+        for (int i : affected)
+        {
+            m_affected[i] = 0;
+        }
+        Relax(open);
+    }
+};
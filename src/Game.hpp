@@ -1,21 +1,54 @@
 #pragma once
 #include "Tako.hpp"
+#include "Graphics.hpp"
 #include "World.hpp"
 #include "Font.hpp"
 #include "Position.hpp"
 #include "Renderer.hpp"
 #include "Player.hpp"
+#include "Actions.hpp"
 #include "Physics.hpp"
 #include "Crop.hpp"
 #include "Level.hpp"
 #include "Objects.hpp"
+#include "Interactions.hpp"
+#include "Events.hpp"
+#include "Telemetry.hpp"
+#include "Commands.hpp"
+#include "ItemPool.hpp"
+#include "GameAssets.hpp"
+#include "Mixer.hpp"
+#include "Farmhand.hpp"
+#include "Bot.hpp"
+#include "Parallel.hpp"
+#include "Particles.hpp"
+#include "Replication.hpp"
+#include "TripleBuffer.hpp"
+#include <condition_variable>
+#include <mutex>
 #include <sstream>
+#include <thread>
+#ifdef __EMSCRIPTEN__
+#include <emscripten.h>
+#endif
 
 constexpr auto DAY_LENGTH = 60.0f;
+// "/MegaFarm.txt" plays on a generated farm instead
+constexpr auto LEVEL_FILE = "/Level.txt";
+// How often the level file is checked for edits while playing
+constexpr auto RELOAD_INTERVAL = 0.5f;
+// Items of each kind created up front, the pool only grows past this on busy farms
+constexpr auto ITEM_RESERVE = 32;
+// Background, items lying around, foreground
+constexpr auto SPRITE_LAYERS = 3;
+// Droplets splashing up, soil thrown off a pulled parsnip, sparkles rising from the box
+constexpr ParticleBurst WATER_BURST = {24, 30, 40, 160, 0.6f, 1, tako::Color(90, 160, 255, 255)};
+constexpr ParticleBurst HARVEST_BURST = {32, 40, 60, 200, 0.8f, 2, tako::Color(140, 100, 60, 255)};
+constexpr ParticleBurst DELIVER_BURST = {40, 20, 30, -20, 1.0f, 1, tako::Color(255, 220, 90, 255)};
 
 struct Text
 {
-    tako::Texture* texture;
+    Gfx::Texture* texture;
     tako::Vector2 size;
 };
 
@@ -29,7 +62,50 @@ enum class SCREEN
 
 struct Camera {};
 
-Text CreateText(tako::PixelArtDrawer* drawer, tako::Font* font, std::string_view text)
+enum class DayResult
+{
+    Grown,
+    Rewound,
+    Finished
+};
+
+// Everything one frame draws, captured at the end of an update so drawing never reads the world or the level
+struct RenderFrame
+{
+    struct SpriteDraw
+    {
+        float x;
+        float y;
+        float w;
+        float h;
+        Gfx::Sprite* sprite;
+    };
+
+    struct RectDraw
+    {
+        float x;
+        float y;
+        float w;
+        float h;
+        tako::Color color;
+    };
+
+    SCREEN screen = SCREEN::PressAny;
+    tako::Vector2 camera;
+    // Tiles and sprites are drawn in the day's light
+    tako::Color light;
+    std::vector<Level::TileDraw> tiles;
+    std::vector<RectDraw> rects;
+    std::vector<SpriteDraw> sprites;
+    // Already in the day's light
+    std::vector<ParticleDraw> particles;
+    Gfx::Sprite* held = nullptr;
+    int day = 0;
+    int parsnips = 0;
+    int clock = 0;
+};
+
+Text CreateText(Gfx::Drawer* drawer, tako::Font* font, std::string_view text)
 {
     auto bitmap = font->RenderText(text, 1);
     auto texture = drawer->CreateTexture(bitmap);
@@ -40,7 +116,7 @@ Text CreateText(tako::PixelArtDrawer* drawer, tako::Font* font, std::string_view
     };
 }
 
-void RerenderText(Text& tex, tako::PixelArtDrawer* drawer, tako::Font* font, std::string_view text)
+void RerenderText(Text& tex, Gfx::Drawer* drawer, tako::Font* font, std::string_view text)
 {
     auto bitmap = font->RenderText(text, 1);
     drawer->UpdateTexture(tex.texture, bitmap);
@@ -61,102 +137,167 @@ tako::Vector2 FitMapBound(Rect bounds, tako::Vector2 cameraPos, tako::Vector2 ca
 class Game
 {
 public:
-    void Setup(tako::PixelArtDrawer* drawer, tako::Resources* resources)
-    {
-        m_drawer = drawer;
-        drawer->SetTargetSize(240, 135);
-        drawer->AutoScale();
-
-        m_font = new tako::Font("/charmap-cellphone.png", 5, 7, 1, 1, 2, 2,
-                                " !\"#$%&'()*+,-./0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]\a_`abcdefghijklmnopqrstuvwxyz{|}~");
-
-        m_waterCan = drawer->CreateSprite(resources->Load<tako::Texture>("/Watercan.png"), 0, 0, 16, 16);
-        m_seedBag = drawer->CreateSprite(resources->Load<tako::Texture>("/SeedBag.png"), 0, 0, 16, 16);
-        m_parsnip = drawer->CreateSprite(resources->Load<tako::Texture>("/Parsnip.png"), 0, 0, 16, 16);
-        m_parsnipUI = resources->Load<tako::Texture>("/ParsnipUI.png");
-        auto playerBit = resources->Load<tako::Texture>("/Player.png");
-        for (int i = 0; i < m_playerSprites.size(); i++)
-        {
-            m_playerSprites[i] = drawer->CreateSprite(playerBit, i * 16, 0, 16, 24);
-        }
-        LoadClips();
-
-        m_level.Init(drawer, resources);
-        std::map<char, std::function<void(int,int)>> dummyMap;
-        m_level.LoadLevel("/Level.txt", dummyMap);
-
-        m_textPressAny = CreateText(drawer, m_font, "Press a button to start");
-        m_textTitle = CreateText(drawer, m_font, "HARVEST\nMINUTE");
-        m_textControls = CreateText(drawer, m_font, " WASD - Move\n  L/C - Pickup/Drop\n  K/X - Use held item\nEnter - Skip to end of day");
-        m_textCredits = CreateText(drawer, m_font, "Made in 72 hours by Malai\nLudum Dare 47 - Stuck in a loop");
-        m_textEndScreen = CreateText(drawer, m_font, "This is a bug");
-    }
-
-    void StartGame()
+    void Setup(Gfx::Drawer* drawer)
     {
-        InitGame();
+        Setup(GameAssets::Load(drawer));
     }
 
-    void InitGame()
+    // Games given the same assets share nothing else, any number of them can be stepped on different threads at once
+    void Setup(std::shared_ptr<GameAssets> assets)
     {
-        m_world.Reset();
-        m_currentDay = 0;
+        m_assets = std::move(assets);
+        m_clipsPending = m_assets->Presentable();
+        RegisterInteractions();
+        if (m_assets->Presentable())
+        {
+            m_events.Subscribe([&](const std::vector<Event>& events) { QueueSounds(events); });
+        }
 
-        std::map<char, std::function<void(int,int)>> levelCallbacks
+        m_level.Init(&m_assets->tileSprites);
+        m_spawnCallbacks =
         {{
-            {'S', [&](int x, int y)
+            {'S', [&](const Spawn& spawn)
+            {
+                m_playerSpawn = tako::Vector2(spawn.x * 16 + 8, spawn.y * 16 + 8);
+            }},
+            {'C', [&](const Spawn& spawn)
+            {
+                if (spawn.state.empty())
+                {
+                    // Crops from the level were planted before the game started
+                    auto& history = m_world.GetComponent<Crop>(CreateCrop(spawn.x, spawn.y)).stageHistory;
+                    std::fill(history.begin(), history.begin() + m_currentDay + 1, 1);
+                }
+                else
+                {
+                    RestoreCrop(spawn);
+                }
+            }},
+            {'W', [&](const Spawn& spawn)
             {
-                m_playerSpawn = tako::Vector2(x * 16 + 8, y * 16 + 8);
+                SpawnBuilding(spawn.x, spawn.y, BUILDING_INFO.at('W'), Well());
             }},
-            {'C', [&](int x, int y)
+            {'B', [&](const Spawn& spawn)
             {
-                CreateCrop(x, y);
+                SpawnBuilding(spawn.x, spawn.y, BUILDING_INFO.at('B'), TransportBox());
             }},
-            {'W', [&](int x, int y)
+            {'b', [&](const Spawn& spawn)
             {
-                SpawnBuilding(x, y, BUILDING_INFO.at('W'), Well());
+                SpawnObject(spawn.x, spawn.y, m_assets->seedBag, SeedBag());
             }},
-            {'B', [&](int x, int y)
+            {'w', [&](const Spawn& spawn)
             {
-                SpawnBuilding(x, y, BUILDING_INFO.at('B'), TransportBox());
+                WateringCan can;
+                if (!spawn.state.empty())
+                {
+                    can.left = spawn.state[0];
+                }
+                SpawnObject(spawn.x, spawn.y, m_assets->waterCan, can);
             }},
-            {'b', [&](int x, int y)
+            {'p', [&](const Spawn& spawn)
             {
-                SpawnObject(x, y, m_seedBag, SeedBag());
+                Parsnip snip;
+                snip.harvestDay = spawn.state[0];
+                SpawnObject(spawn.x, spawn.y, m_assets->parsnip, snip);
             }},
-            {'w', [&](int x, int y)
+            {'F', [&](const Spawn& spawn)
             {
-                SpawnObject(x, y, m_waterCan, WateringCan());
+                SpawnFarmhand(spawn.x, spawn.y);
             }}
         }};
-        m_level.LoadLevel("/Level.txt", levelCallbacks);
+        // The title only shows the tiles, but needs to know where a generated farm starts
+        SpawnCallbacks titleMap = {{ {'S', m_spawnCallbacks['S']} }};
+        m_level.LoadLevel(LEVEL_FILE, titleMap);
+
+        m_textPressAny = MakeText("Press a button to start");
+        m_textTitle = MakeText("HARVEST\nMINUTE");
+        m_textControls = MakeText(" WASD - Move\n  L/C - Pickup/Drop\n  K/X - Use held item\nEnter - Skip to end of day");
+        m_textCredits = MakeText("Made in 72 hours by Malai\nLudum Dare 47 - Stuck in a loop");
+        m_textEndScreen = MakeText("This is a bug");
+        // Restarts render into the same HUD textures
+        m_currentDayText = MakeText("Day 1");
+        m_dayTimeLeftText = MakeText("60");
+        m_parsnipText = MakeText("0");
+        ViewChanged();
+    }
+
+    void StartGame()
+    {
+        InitGame();
+    }
+
+    void InitGame()
+    {
+        m_world.Reset();
+        m_items.Clear();
+        m_items.Reserve<WateringCan>(m_world, ITEM_RESERVE);
+        m_items.Reserve<SeedBag>(m_world, ITEM_RESERVE);
+        m_items.Reserve<Parsnip>(m_world, ITEM_RESERVE);
+        m_particles.Clear();
+        m_currentDay = 0;
 
+        // Setup already read the level, edits since then have been picked up by WatchLevel
+        m_level.Restart(m_spawnCallbacks);
+        InitFields();
+
+        for (int slot = 0; slot < MAX_PLAYERS; slot++)
         {
-            auto player = m_world.Create<Position, SpriteRenderer, AnimatedSprite, Player, RigidBody, Foreground, Camera>();
-            Position& pos = m_world.GetComponent<Position>(player);
-            pos = m_playerSpawn;
-            RigidBody& rigid = m_world.GetComponent<RigidBody>(player);
-            rigid.size = { 15, 15 };
-            rigid.entity = player;
-            SpriteRenderer& renderer = m_world.GetComponent<SpriteRenderer>(player);
-            renderer.size = { 16, 24};
-            renderer.sprite = m_playerSprites[0];
-            renderer.offset = {0, 8};
-            AnimatedSprite& anim = m_world.GetComponent<AnimatedSprite>(player);
-            anim.SetStatic(&m_playerSprites[0]);
-            Player& play = m_world.GetComponent<Player>(player);
-            play.facing = { 0, -1 };
-            play.heldObject = std::nullopt;
+            if (m_players & (1 << slot))
+            {
+                SpawnPlayer(slot);
+            }
         }
         m_currentDay = 1;
-        m_currentDayText = CreateText(m_drawer, m_font, "Day " + std::to_string(m_currentDay));
         m_dayTimeLeft = DAY_LENGTH;
-        m_dayTimeLeftText = CreateText(m_drawer, m_font, std::to_string(m_dayTimeLeft));
+        m_dayTimeLeftPrev = -1;
         m_parsnipCount = m_parsnipCountPrev = m_parsnipCountSafe = 0;
-        m_parsnipText = CreateText(m_drawer, m_font, std::to_string(m_parsnipCount));
         m_screen = SCREEN::Game;
     }
 
+    // Everyone starts on the spawn, the view follows the host's own player
+    tako::Entity SpawnPlayer(int slot)
+    {
+        auto player = slot == 0
+            ? m_world.Create<Position, SpriteRenderer, AnimatedSprite, Player, RigidBody, Foreground, Camera>()
+            : m_world.Create<Position, SpriteRenderer, AnimatedSprite, Player, RigidBody, Foreground>();
+        Position& pos = m_world.GetComponent<Position>(player);
+        pos = m_playerSpawn;
+        RigidBody& rigid = m_world.GetComponent<RigidBody>(player);
+        rigid.size = { 15, 15 };
+        rigid.entity = player;
+        rigid.walksApart = true;
+        SpriteRenderer& renderer = m_world.GetComponent<SpriteRenderer>(player);
+        renderer.size = { 16, 24};
+        renderer.sprite = m_assets->playerSprites[0];
+        renderer.offset = {0, 8};
+        AnimatedSprite& anim = m_world.GetComponent<AnimatedSprite>(player);
+        anim.SetStatic(&m_assets->playerSprites[0]);
+        Player& play = m_world.GetComponent<Player>(player);
+        play.facing = { 0, -1 };
+        play.heldObject = std::nullopt;
+        play.slot = slot;
+        return player;
+    }
+
+    // What they held is gone with them
+    void RemovePlayer(int slot)
+    {
+        m_world.IterateHandle<Player>([&](tako::EntityHandle handle)
+        {
+            auto& player = m_world.GetComponent<Player>(handle.id);
+            if (player.slot != slot)
+            {
+                return;
+            }
+            if (player.heldObject)
+            {
+                m_items.Release(m_world, player.heldObject.value());
+            }
+            m_commands.Delete(handle.id);
+        });
+        Sync();
+    }
+
     template<class T>
     tako::Entity SpawnBuilding(int x, int y, const BuildingSize& size, T type)
     {
@@ -166,6 +307,7 @@ public:
         Interactable& inter = m_world.GetComponent<Interactable>(entity);
         inter.w = size.x * 16;
         inter.h = size.y * 16;
+        inter.type = TargetTypeOf(type);
         T& t = m_world.GetComponent<T>(entity);
         t = type;
         return entity;
@@ -202,92 +344,438 @@ public:
         return crop;
     }
 
+    // Puts back a crop that left with its chunk, its tile was saved with the chunk
+    tako::Entity RestoreCrop(const Spawn& spawn)
+    {
+        auto crop = m_world.Create<Position, Crop, Background>();
+        Position& pos = m_world.GetComponent<Position>(crop);
+        pos.x = spawn.x * 16 + 8;
+        pos.y = spawn.y * 16 + 8;
+        Crop& cr = m_world.GetComponent<Crop>(crop);
+        cr.stage = spawn.state[0];
+        cr.watered = spawn.state[1];
+        // It didn't grow while it was away
+        std::copy(spawn.state.begin() + 2, spawn.state.end(), cr.stageHistory.begin());
+        std::fill(cr.stageHistory.begin() + spawn.state.size() - 2, cr.stageHistory.begin() + m_currentDay + 1, cr.stage);
+        cr.tileX = spawn.x;
+        cr.tileY = spawn.y;
+        return crop;
+    }
+
+    // Empty for a crop the level would spawn the same way today, so untouched chunks don't need saving
+    std::vector<int> CropState(const Crop& crop)
+    {
+        auto history = crop.stageHistory.begin();
+        bool untouched = crop.stage == 1 && !crop.watered && std::all_of(history, history + m_currentDay, [](int stage) { return stage == 1; });
+        if (untouched)
+        {
+            return {};
+        }
+        std::vector<int> state = { crop.stage, crop.watered };
+        state.insert(state.end(), history, history + m_currentDay + 1);
+        return state;
+    }
+
     template<class T>
-    tako::Entity SpawnObject(int x, int y, tako::Sprite* sprite, T type)
+    tako::Entity SpawnObject(int x, int y, Gfx::Sprite* sprite, T type)
+    {
+        auto entity = m_items.Take(m_world, sprite, type);
+        m_items.Place(m_world, entity, x, y);
+        return entity;
+    }
+
+    // Items lying on the ground, stored and held ones keep their Pickup but are skipped
+    template<class F>
+    void IteratePlaced(F f)
+    {
+        m_world.IterateComps<Pickup, Item>([&](Pickup& pickup, Item& item)
+        {
+            if (item.state == ItemState::Placed)
+            {
+                f(pickup);
+            }
+        });
+    }
+
+    tako::Entity SpawnFarmhand(int x, int y)
     {
-        auto entity = m_world.Create<Position, SpriteRenderer, RigidBody, Pickup, Background, T>();
+        auto entity = m_world.Create<Position, SpriteRenderer, AnimatedSprite, Farmhand, RigidBody, Foreground>();
         Position& pos = m_world.GetComponent<Position>(entity);
         pos.x = x * 16 + 8;
         pos.y = y * 16 + 8;
-        SpriteRenderer& ren = m_world.GetComponent<SpriteRenderer>(entity);
-        ren.sprite = sprite;
-        ren.size = {16, 16};
         RigidBody& rigid = m_world.GetComponent<RigidBody>(entity);
-        rigid.size = {14, 14};
+        rigid.size = { 15, 15 };
         rigid.entity = entity;
-        T& t = m_world.GetComponent<T>(entity);
-        t = type;
-        Pickup& pickup = m_world.GetComponent<Pickup>(entity);
-        pickup.x = x;
-        pickup.y = y;
-        pickup.entity = entity;
+        SpriteRenderer& renderer = m_world.GetComponent<SpriteRenderer>(entity);
+        renderer.size = { 16, 24 };
+        renderer.sprite = m_assets->playerSprites[0];
+        renderer.offset = {0, 8};
+        AnimatedSprite& anim = m_world.GetComponent<AnimatedSprite>(entity);
+        anim.SetStatic(&m_assets->playerSprites[0]);
+        Farmhand& hand = m_world.GetComponent<Farmhand>(entity);
+        hand = Farmhand();
+        hand.facing = { 0, -1 };
+        hand.home = pos.AsVec();
+        hand.task = FarmhandTask::Idle;
 
         return entity;
     }
 
+    // Records gameplay events to file until the game is destroyed
+    bool OpenTelemetry(const char* file)
+    {
+        return m_telemetry.Open(file);
+    }
+
+    // The player is driven by the planning bot from now on, rollouts per choice of next task.
+    // Bots with the same seed on the same farm play the same game
+    void EnableBot(int rollouts = Bot::ROLLOUTS, uint64_t seed = 1)
+    {
+        m_botRollouts = rollouts;
+        m_botSeed = seed;
+        m_botHand.task = FarmhandTask::Idle;
+    }
+
+    // Up to MAX_PLAYERS - 1 others join through the transport and farm along. This game runs the farm for
+    // all of them and sends each what changed in their view every update
+    void Host(std::unique_ptr<Transport> transport)
+    {
+        m_server = std::make_unique<ReplicaServer>(std::move(transport));
+        m_events.Subscribe([&](const std::vector<Event>& events) { m_netSounds |= SoundsOf(events); });
+    }
+
+    // Plays on a farm another game hosts, this one has no world of its own and only shows what comes back
+    void Join(std::unique_ptr<Transport> transport)
+    {
+        m_client = std::make_unique<ReplicaClient>(std::move(transport));
+        m_musicWanted = m_assets->Presentable();
+    }
+
+    // Bytes of every snapshot sent to clients so far
+    uint64_t BytesServed() const
+    {
+        return m_server ? m_server->BytesSent() : 0;
+    }
+
+    // The voices the game's sounds are mixed on, advanced or rendered by whoever owns the output
+    Mixer& Audio()
+    {
+        return m_mixer;
+    }
+
+    int Parsnips() const
+    {
+        return m_client ? m_client->Latest().parsnips : m_parsnipCount;
+    }
+
+    bool IsOver() const
+    {
+        return m_client ? m_client->Latest().screen == (uint8_t) SCREEN::EndScreen : m_screen == SCREEN::EndScreen;
+    }
+
+    uint32_t Frames() const
+    {
+        return m_frame;
+    }
+
+    // Which keys do what, changes apply from the next update
+    InputMap& Bindings()
+    {
+        return m_inputMap;
+    }
+
     void Update(tako::Input* input, float dt)
     {
+        Update(m_inputMap.Snapshot(input), dt);
+    }
+
+    // Recorded or remote input plays the same as local keys
+    void Update(const ActionState& actions, float dt)
+    {
+        if (!m_updateThread.joinable())
+        {
+            ViewChanged();
+            Step(actions, dt);
+            LoadClips();
+            return;
+        }
+        // The step before has to finish first, this one then runs while its frame is drawn
+        Finish();
+        ViewChanged();
+        LoadClips();
+        {
+            std::lock_guard<std::mutex> lock(m_stepMutex);
+            m_stepActions = actions;
+            m_stepDt = dt;
+            m_stepQueued = true;
+        }
+        m_stepWake.notify_one();
+    }
+
+    // Updates run on a thread of their own from now on, each one overlapping with drawing the frame before it.
+    // Drawing stays on the caller's thread, which owns the drawer. Read the game only after Finish
+    void EnableUpdateThread()
+    {
+#ifndef __EMSCRIPTEN__
+        if (!m_updateThread.joinable())
+        {
+            m_updateThread = std::thread([this] { RunUpdates(); });
+            // The world is only touched from there now, its update graphs need it to be the main thread to run in parallel.
+            // Nothing runs on it before the next Update
+            m_previousMainThread = Parallel::GetScheduler().BindMainThread(m_updateThread.get_id());
+        }
+#endif
+    }
+
+    // Stops the update thread once the update in flight is done and hands the scheduler's main thread back.
+    // A static game has to call this before static destruction, the scheduler may be gone before the game is
+    void StopUpdateThread()
+    {
+        if (!m_updateThread.joinable())
+        {
+            return;
+        }
+        JoinUpdates();
+        Parallel::GetScheduler().BindMainThread(m_previousMainThread);
+    }
+
+    // Waits for the update in flight
+    void Finish()
+    {
+        std::unique_lock<std::mutex> lock(m_stepMutex);
+        m_stepDone.wait(lock, [&] { return !m_stepQueued; });
+    }
+
+    // Leaves the scheduler alone, StopUpdateThread hands its main thread back
+    ~Game()
+    {
+        JoinUpdates();
+    }
+
+    void Step(const ActionState& actions, float dt)
+    {
+        m_frame++;
+        if (m_client)
+        {
+            m_client->SendInput(actions, m_viewSize);
+            m_client->Receive();
+            m_sounds.fetch_or(m_client->TakeSounds(), std::memory_order_relaxed);
+            if (m_assets->Presentable())
+            {
+                CaptureReplica();
+            }
+            return;
+        }
+        if (m_server)
+        {
+            ServeInputs();
+        }
         switch (m_screen)
         {
             case SCREEN::PressAny:
-                if (GetAnyDown(input))
+                if (actions.AnyPressed())
                 {
-                    tako::Audio::Play(*m_clipMusic, true);
+                    // Starts as soon as the music is there
+                    m_musicWanted = true;
                     m_screen = SCREEN::Title;
                 }
                 break;
             case SCREEN::Title:
-                if (GetAnyDown(input))
+                if (actions.AnyPressed())
                 {
                     StartGame();
                 }
                 break;
             case SCREEN::Game:
-                GameUpdate(input, dt);
+                WatchLevel(dt);
+                GameUpdate(actions, dt);
                 break;
             case SCREEN::EndScreen:
-                if (input->GetKeyDown(tako::Key::Enter) || input->GetKeyDown(tako::Key::Gamepad_Start))
+                if (actions.Pressed(Action::Start))
                 {
                     InitGame();
                 }
                 break;
         }
+        if (m_server)
+        {
+            ServeSnapshots();
+        }
+        if (m_assets->Presentable())
+        {
+            Capture();
+        }
     }
 
-    bool GetAnyDown(tako::Input* input)
+    void GameUpdate(const ActionState& actions, float dt)
     {
-        for (int i = 0; i < (int) tako::Key::Unknown; i++)
+        // Anything changing the world's structure or touching the drawer stays on the main thread,
+        // the workers tick animations while the main thread hands the frame's events to audio and HUD
+        Parallel::Graph frame;
+        // Every phase ends in a sync point applying the structural changes it recorded
+        auto stream = frame.AddMain([&] { StreamLevel(); });
+        std::array<Controls, MAX_PLAYERS> controls;
+        auto control = frame.AddMain([&]
         {
-            if (input->GetKeyDown((tako::Key) i))
+            controls[0] = m_botRollouts > 0 ? BotControls(dt) : ReadControls(actions);
+            for (int slot = 1; slot < MAX_PLAYERS; slot++)
             {
-                return true;
+                controls[slot] = ReadControls(m_remoteActions[slot]);
             }
+            UpdatePlayers(controls, dt);
+            Sync();
+        }, {stream});
+        auto farmhands = frame.AddMain([&] { UpdateFarmhands(dt); Sync(); }, {control});
+        auto clock = frame.AddMain([&] { UpdateClock(controls, dt); Sync(); }, {farmhands});
+        frame.Add([&] { Animate(dt); }, {clock});
+        frame.Add([&] { m_particles.Step(dt); }, {clock});
+        frame.AddMain([&] { m_events.Dispatch(); }, {clock});
+        frame.Run();
+    }
+
+    // Edits to the level file show up in the running game, only the cells that changed are respawned
+    void WatchLevel(float dt)
+    {
+#ifndef __EMSCRIPTEN__
+        m_reloadTimer -= dt;
+        if (m_reloadTimer > 0)
+        {
+            return;
+        }
+        m_reloadTimer = RELOAD_INTERVAL;
+        switch (m_level.Reload(LEVEL_FILE, m_spawnCallbacks, [&](TileArea area) { return EvictArea(area); }))
+        {
+            case Level::ReloadResult::Unchanged:
+                break;
+            case Level::ReloadResult::Patched:
+                Sync();
+                InitFields();
+                break;
+            case Level::ReloadResult::NeedsLoad:
+                InitGame();
+                break;
         }
+#endif
+    }
 
-        return false;
+    // Every player keeps the farm around them loaded
+    void StreamLevel()
+    {
+        std::vector<tako::Vector2> foci;
+        m_world.IterateComps<Position, Player>([&](Position& pos, Player& player)
+        {
+            foci.push_back(pos.AsVec());
+        });
+        if (m_level.Stream(foci, m_spawnCallbacks, [&](TileArea area) { return EvictArea(area); }))
+        {
+            Sync();
+            InitFields();
+        }
     }
 
-    void GameUpdate(tako::Input* input, float dt)
+    // Takes everything belonging to the area out of the world, farmhands living elsewhere are sent home
+    std::vector<Spawn> EvictArea(TileArea area)
     {
-        m_world.IterateComps<Position, Player, RigidBody, SpriteRenderer, AnimatedSprite>([&](Position& pos, Player& player, RigidBody& rigid, SpriteRenderer& spriteRenderer, AnimatedSprite& anim)
+        auto inside = [&](int x, int y)
+        {
+            return x >= area.x0 && x <= area.x1 && y >= area.y0 && y <= area.y1;
+        };
+        std::vector<Spawn> spawns;
+        auto [spawnX, spawnY] = Farmhands::TileOf(m_playerSpawn);
+        if (inside(spawnX, spawnY))
+        {
+            spawns.push_back({'S', spawnX, spawnY, {}});
+        }
+        m_world.IterateHandle<Crop>([&](tako::EntityHandle handle)
+        {
+            Crop& crop = m_world.GetComponent<Crop>(handle.id);
+            if (inside(crop.tileX, crop.tileY))
+            {
+                spawns.push_back({'C', crop.tileX, crop.tileY, CropState(crop)});
+                m_commands.Delete(handle.id);
+            }
+        });
+        IteratePlaced([&](Pickup& pickup)
         {
-            tako::Vector2 moveVector;
-            if (input->GetKey(tako::Key::Left) || input->GetKey(tako::Key::A) || input->GetKey(tako::Key::Gamepad_Dpad_Left))
+            if (!inside(pickup.x, pickup.y))
+            {
+                return;
+            }
+            switch (m_world.GetComponent<Item>(pickup.entity).type)
             {
-                moveVector.x -= 1;
+                case ItemType::WateringCan:
+                {
+                    int left = m_world.GetComponent<WateringCan>(pickup.entity).left;
+                    spawns.push_back({'w', pickup.x, pickup.y, left == WateringCan().left ? std::vector<int>() : std::vector<int>{left}});
+                    break;
+                }
+                case ItemType::SeedBag:
+                    spawns.push_back({'b', pickup.x, pickup.y, {}});
+                    break;
+                case ItemType::Parsnip:
+                    spawns.push_back({'p', pickup.x, pickup.y, {m_world.GetComponent<Parsnip>(pickup.entity).harvestDay}});
+                    break;
+                default:
+                    break;
             }
-            if (input->GetKey(tako::Key::Right) || input->GetKey(tako::Key::D) || input->GetKey(tako::Key::Gamepad_Dpad_Right))
+            m_items.Release(m_world, pickup.entity);
+        });
+        m_world.IterateHandle<Position, Interactable>([&](tako::EntityHandle handle)
+        {
+            auto& interactable = m_world.GetComponent<Interactable>(handle.id);
+            auto& iPos = m_world.GetComponent<Position>(handle.id);
+            // Back to the top left tile SpawnBuilding was given
+            int x = (int) (iPos.x - interactable.w / 2) / 16;
+            int y = (int) (iPos.y + interactable.h / 2) / 16 - 1;
+            if (inside(x, y))
             {
-                moveVector.x += 1;
+                spawns.push_back({interactable.type == TargetType::Well ? 'W' : 'B', x, y, {}});
+                m_commands.Delete(handle.id);
             }
-            if (input->GetKey(tako::Key::Up) || input->GetKey(tako::Key::W) || input->GetKey(tako::Key::Gamepad_Dpad_Up))
+        });
+        m_world.IterateHandle<Position, Farmhand>([&](tako::EntityHandle handle)
+        {
+            auto& hand = m_world.GetComponent<Farmhand>(handle.id);
+            auto& pos = m_world.GetComponent<Position>(handle.id);
+            auto [homeX, homeY] = Farmhands::TileOf(hand.home);
+            auto [x, y] = Farmhands::TileOf(pos.AsVec());
+            if (inside(homeX, homeY))
             {
-                moveVector.y += 1;
+                // Whatever they carried doesn't come back
+                spawns.push_back({'F', homeX, homeY, {}});
+                m_commands.Delete(handle.id);
+                if (hand.heldObject)
+                {
+                    m_items.Release(m_world, hand.heldObject.value());
+                }
             }
-            if (input->GetKey(tako::Key::Down) || input->GetKey(tako::Key::S) || input->GetKey(tako::Key::Gamepad_Dpad_Down))
+            else if (inside(x, y))
             {
-                moveVector.y -= 1;
+                pos = hand.home;
+                hand.task = FarmhandTask::Idle;
             }
+        });
+        return spawns;
+    }
+
+    static Controls ReadControls(const ActionState& actions)
+    {
+        Controls controls;
+        controls.move.x = actions.Held(Action::MoveRight) - actions.Held(Action::MoveLeft);
+        controls.move.y = actions.Held(Action::MoveUp) - actions.Held(Action::MoveDown);
+        controls.pickup = actions.Pressed(Action::Pickup);
+        controls.use = actions.Pressed(Action::Use);
+        controls.skipDay = actions.Pressed(Action::SkipDay);
+        return controls;
+    }
+
+    // Each player by the controls of their slot
+    void UpdatePlayers(const std::array<Controls, MAX_PLAYERS>& slots, float dt)
+    {
+        std::vector<tako::Entity> actors;
+        m_world.IterateComps<Position, Player, RigidBody, SpriteRenderer, AnimatedSprite>([&](Position& pos, Player& player, RigidBody& rigid, SpriteRenderer& spriteRenderer, AnimatedSprite& anim)
+        {
+            tako::Vector2 moveVector = slots[player.slot].move;
             auto moveMagnitude = moveVector.magnitude();
             bool changedFacing = false;
             if (moveMagnitude > 1)
@@ -307,395 +795,1212 @@ public:
             Physics::Move(m_world, m_level, pos, rigid, moveVector * dt * 30);
             if ((!player.wasMoving || changedFacing) && moveMagnitude > 0)
             {
-                anim.SetAnim(0.15f, &m_playerSprites[GetIdleIndex(player.facing)], 4);
-                spriteRenderer.sprite = m_playerSprites[GetIdleIndex(player.facing)+1];
+                anim.SetAnim(0.15f, &m_assets->playerSprites[GetIdleIndex(player.facing)], 4);
+                spriteRenderer.sprite = m_assets->playerSprites[GetIdleIndex(player.facing)+1];
                 anim.passed = 0;
             }
             else if ((player.wasMoving || changedFacing) && moveMagnitude == 0)
             {
-                anim.SetStatic(&m_playerSprites[GetIdleIndex(player.facing)]);
+                anim.SetStatic(&m_assets->playerSprites[GetIdleIndex(player.facing)]);
             }
             player.wasMoving = moveMagnitude > 0;
 
-            float interActX = pos.x + player.facing.x * 12;
-            float interActY = pos.y + player.facing.y * 12;
-            int tileX = ((int) interActX) / 16;
-            int tileY = ((int) interActY) / 16;
+            actors.push_back(rigid.entity);
+        });
+
+        // Interactions change the world, so they run once the iteration is done
+        for (auto entity : actors)
+        {
+            auto& pos = m_world.GetComponent<Position>(entity);
+            auto& player = m_world.GetComponent<Player>(entity);
+            auto& controls = slots[player.slot];
             //Pickup drop
-            if (input->GetKeyDown(tako::Key::L) || input->GetKeyDown(tako::Key::C) || input->GetKeyDown(tako::Key::Gamepad_A))
+            if (controls.pickup)
             {
-                bool didInteract = false;
-                m_world.IterateHandle<Position, Interactable>([&](tako::EntityHandle handle)
-                {
-                    auto& interactable = m_world.GetComponent<Interactable>(handle.id);
-                    auto& iPos = m_world.GetComponent<Position>(handle.id);
-                    Rect interRect(iPos.x, iPos.y, interactable.w, interactable.h);
-                    if (!interRect.PointInside(interActX, interActY))
-                    {
-                        return;
-                    }
-
-                    if (m_world.HasComponent<Well>(handle.id))
-                    {
-                        if (player.heldObject)
-                        {
-                            auto held = player.heldObject.value();
-                            if (m_world.HasComponent<WateringCan>(held))
-                            {
-                                auto& watering = m_world.GetComponent<WateringCan>(held);
-                                watering = WateringCan();
-                                tako::Audio::Play(*m_clipSplash);
-                                didInteract = true;
-                            }
-                            return;
-                        }
-                        auto obj = SpawnObject(tileX, tileY, m_waterCan, WateringCan());
-                        m_world.RemoveComponent<Position>(obj);
-                        m_world.RemoveComponent<Pickup>(obj);
-                        player.heldObject = obj;
-                        tako::Audio::Play(*m_clipSplash);
-                        didInteract = true;
-                    }
-                    else if (m_world.HasComponent<TransportBox>(handle.id))
-                    {
-                        if (!player.heldObject)
-                        {
-                            return;
-                        }
-                        auto held = player.heldObject.value();
-                        if (m_world.HasComponent<Parsnip>(held))
-                        {
-                            if (m_world.GetComponent<Parsnip>(held).harvestDay < m_currentDay)
-                            {
-                                m_parsnipCountSafe++;
-                            }
-                            m_world.Delete(held);
-                            player.heldObject = std::nullopt;
-                            m_parsnipCount++;
-                            RerenderText(m_parsnipText, m_drawer, m_font, std::to_string(m_parsnipCount));
-                            tako::Audio::Play(*m_clipSend);
-                            didInteract = true;
-                        }
-                    }
-                });
-                if (!didInteract)
-                {
-                    if (!player.heldObject)
-                    {
-                        m_world.IterateComps<Pickup>([&](Pickup& pickup)
-                        {
-                            if (player.heldObject)
-                            {
-                                return;
-                            }
-                            if (pickup.x != tileX || pickup.y != tileY)
-                            {
-                                return;
-                            }
-
-                            player.heldObject = pickup.entity;
-                            tako::Audio::Play(*m_clipPickup);
-                        });
-                        m_world.IterateComps<Crop>([&](Crop& crop)
-                        {
-                            if (player.heldObject)
-                            {
-                                return;
-                            }
-                            if (crop.tileX != tileX || crop.tileY != tileY)
-                            {
-                                return;
-                            }
-                            if (crop.stage == 4)
-                            {
-                                crop.stage = -69;
-                                Parsnip snip;
-                                snip.harvestDay = m_currentDay;
-                                player.heldObject = SpawnObject(tileX, tileY, m_parsnip, snip);
-                                m_level.GetTile(tileX, tileY).value()->index = crop.watered ? 2 : 1;
-                                crop.watered = true;
-                                tako::Audio::Play(*m_clipHarvest);
-                            }
-                        });
-                        if (player.heldObject)
-                        {
-                            auto obj = player.heldObject.value();
-                            m_world.RemoveComponent<Position>(obj);
-                            m_world.RemoveComponent<Pickup>(obj);
-                        }
-                        else
-                        {
-                            tako::Audio::Play(*m_clipError);
-                        }
-                    }
-                    else
-                    {
-                        // Find out if tile is free
-                        auto blocked = ((int) m_playerSpawn.x) / 16 == tileX && ((int) m_playerSpawn.y) / 16 == tileY;
-                        m_world.IterateComps<Pickup>([&](Pickup& pickup)
-                        {
-                            if (blocked)
-                            {
-                                return;
-                            }
-                            if (pickup.x != tileX || pickup.y != tileY)
-                            {
-                                return;
-                            }
-
-                            blocked = true;
-                        });
-                        if (!blocked)
-                        {
-                            m_world.IterateComps<Crop>([&](Crop& crop)
-                            {
-                                if (blocked)
-                                {
-                                    return;
-                                }
-                                if (crop.tileX != tileX || crop.tileY != tileY || crop.stage <= 0)
-                                {
-                                    return;
-                                }
-
-                                blocked = true;
-                            });
-                        }
-                        if (!blocked)
-                        {
-                            m_world.IterateHandle<Position, Interactable>([&](tako::EntityHandle handle)
-                            {
-                                if (blocked)
-                                {
-                                    return;
-                                }
-                                auto &interactable = m_world.GetComponent<Interactable>(handle.id);
-                                auto &iPos = m_world.GetComponent<Position>(handle.id);
-                                Rect interRect(iPos.x, iPos.y, interactable.w, interactable.h);
-                                if (interRect.PointInside(interActX, interActY))
-                                {
-                                    blocked = true;
-                                    return;
-                                }
-                            });
-                        }
-
-                        if (!blocked)
-                        {
-                            auto obj = player.heldObject.value();
-                            m_world.AddComponent<Pickup>(obj);
-                            m_world.AddComponent<Position>(obj);
-                            Position& p = m_world.GetComponent<Position>(obj);
-                            p.x = tileX * 16 + 8;
-                            p.y = tileY * 16 + 8;
-                            Pickup& pickup = m_world.GetComponent<Pickup>(obj);
-                            pickup.x = tileX;
-                            pickup.y = tileY;
-                            pickup.entity = obj;
-                            player.heldObject = std::nullopt;
-                            Rect placed(p.x, p.y, 16, 16);
-                            Rect self(pos.x, pos.y, rigid.size.x, rigid.size.y);
-                            if (player.facing.x && Rect::OverlapX(self, placed))
-                            {
-                                pos.x += tako::mathf::sign(pos.x - p.x) * (16 - tako::mathf::abs(pos.x - p.x));
-                            }
-                            if (player.facing.y && Rect::OverlapY(self, placed))
-                            {
-                                pos.y += tako::mathf::sign(pos.y - p.y) * (16 - tako::mathf::abs(pos.y - p.y));
-                            }
-                            tako::Audio::Play(*m_clipDrop);
-                        }
-                        else
-                        {
-                            tako::Audio::Play(*m_clipError);
-                        }
-                    }
-                }
+                PickupDrop(pos, m_world.GetComponent<RigidBody>(entity), player);
             }
             // Use/interact
-            if (input->GetKeyDown(tako::Key::K) || input->GetKeyDown(tako::Key::X) || input->GetKeyDown(tako::Key::Gamepad_B))
+            if (controls.use)
             {
-                if (player.heldObject)
-                {
-                    auto obj = player.heldObject.value();
-                    auto tileOpt = m_level.GetTile(tileX, tileY);
-                    if (tileOpt)
-                    {
-                        auto tile = tileOpt.value();
-                        if (m_world.HasComponent<WateringCan>(obj))
+                UseHeld(pos, player);
+            }
+        }
+    }
+
+    // Any player can skip to the end of the day
+    void UpdateClock(const std::array<Controls, MAX_PLAYERS>& slots, float dt)
+    {
+        bool skipDay = std::any_of(slots.begin(), slots.end(), [](const Controls& controls) { return controls.skipDay; });
+        if (m_dayTimeLeft > 3 && skipDay)
+        {
+            m_dayTimeLeft = 3;
+        }
+
+        m_dayTimeLeft -= dt;
+        if (m_dayTimeLeft <= 0)
+        {
+            PassDay();
+        }
+
+        int dayLeft = std::ceil(m_dayTimeLeft);
+        if (dayLeft != m_dayTimeLeftPrev)
+        {
+            Emit(EventType::ClockChanged, true, dayLeft);
+            m_dayTimeLeftPrev = dayLeft;
+        }
+    }
+
+    // Sounds wait as one bit per kind until the next frame is drawn, at most one of each is played
+    void QueueSounds(const std::vector<Event>& events)
+    {
+        m_sounds.fetch_or(SoundsOf(events), std::memory_order_relaxed);
+    }
+
+    static uint32_t SoundsOf(const std::vector<Event>& events)
+    {
+        uint32_t sounds = 0;
+        for (auto& event : events)
+        {
+            if (event.audible && (event.type != EventType::ClockChanged || event.value <= 10))
+            {
+                sounds |= 1u << (uint32_t) event.type;
+            }
+        }
+        return sounds;
+    }
+
+    // Which sounds win when the voices run out and how many of each may overlap. Day changes are rare and
+    // matter most, ticks are the first to go
+    static SoundRule RuleFor(EventType type)
+    {
+        switch (type)
+        {
+            case EventType::DayPassed:
+            case EventType::DayRewound: return {3, 1, 1.0f};
+            case EventType::Harvest:
+            case EventType::Deliver: return {2, 2, 1.0f};
+            case EventType::Error: return {1, 1, 1.0f};
+            case EventType::ClockChanged: return {0, 1, 0.7f};
+            default: return {1, 2, 1.0f};
+        }
+    }
+
+    // The mixer decides whether a sound gets a voice, clips it can't read are played regardless.
+    // When tako plays the clips the mixer only admits them, see Mixer::PlayElsewhere
+    void PlaySounds()
+    {
+        auto sounds = m_sounds.exchange(0, std::memory_order_relaxed);
+        for (int index = 0; sounds; index++, sounds >>= 1)
+        {
+            if (!(sounds & 1))
+            {
+                continue;
+            }
+            auto type = (EventType) index;
+            auto audio = m_assets->Clip(m_assets->ClipFor(type));
+            if (!audio)
+            {
+                continue;
+            }
+            if (auto sound = m_assets->SoundFor(type))
+            {
+                auto voice = m_mixer.Play(sound, RuleFor(type));
+                if (!voice)
+                {
+                    continue;
+                }
+                if (type == EventType::DayPassed || type == EventType::DayRewound)
+                {
+                    // Only a mix the mixer renders itself can cut the tick short
+                    m_mixer.Stop(m_tickVoice, 0.1f);
+                }
+                else if (type == EventType::ClockChanged)
+                {
+                    m_tickVoice = voice;
+                }
+            }
+            tako::Audio::Play(*audio);
+        }
+    }
+
+    // Brings the texts up to date with the frame, each is rendered again only when it changed
+    void Present(const RenderFrame& frame)
+    {
+        if (frame.screen != SCREEN::Game && frame.screen != SCREEN::EndScreen)
+        {
+            return;
+        }
+        if (frame.day != m_shownDay)
+        {
+            UpdateText(m_currentDayText, "Day " + std::to_string(frame.day));
+            m_shownDay = frame.day;
+        }
+        if (frame.parsnips != m_shownParsnips)
+        {
+            UpdateText(m_parsnipText, std::to_string(frame.parsnips));
+            m_shownParsnips = frame.parsnips;
+        }
+        if (frame.clock != m_shownClock)
+        {
+            UpdateText(m_dayTimeLeftText, (frame.clock < 10 ? " " : "") + std::to_string(frame.clock));
+            m_shownClock = frame.clock;
+        }
+        if (frame.screen == SCREEN::EndScreen && frame.parsnips != m_shownEnd)
+        {
+            RenderEndText(frame.parsnips);
+            m_shownEnd = frame.parsnips;
+        }
+        else if (frame.screen == SCREEN::Game)
+        {
+            m_shownEnd = -1;
+        }
+    }
+
+    void Animate(float dt)
+    {
+        std::vector<std::pair<SpriteRenderer*, AnimatedSprite*>> animated;
+        m_world.IterateComps<SpriteRenderer, AnimatedSprite>([&](SpriteRenderer& sprite, AnimatedSprite& anim)
+        {
+            animated.emplace_back(&sprite, &anim);
+        });
+        Parallel::For(animated.size(), 256, [&](int begin, int end)
+        {
+            for (int i = begin; i < end; i++)
+            {
+                auto& sprite = *animated[i].first;
+                auto& anim = *animated[i].second;
+                anim.passed += dt;
+                if (anim.passed >= anim.duration)
+                {
+                    int index = 0;
+                    while (index < anim.frames && anim.sprites[index] != sprite.sprite)
+                    {
+                        index++;
+                    }
+                    index++;
+                    if (index >= anim.frames)
+                    {
+                        sprite.sprite = anim.sprites[0];
+                    }
+                    else
+                    {
+                        sprite.sprite = anim.sprites[index];
+                    }
+                    anim.passed = 0;
+                }
+            }
+        });
+    }
+
+    // Shared by the player and farmhands, Actor needs facing and heldObject
+    template<class Actor>
+    void PickupDrop(Position& pos, RigidBody& rigid, Actor& actor)
+    {
+        float interActX = pos.x + actor.facing.x * 12;
+        float interActY = pos.y + actor.facing.y * 12;
+        int tileX = ((int) interActX) / 16;
+        int tileY = ((int) interActY) / 16;
+        std::optional<tako::Entity> target;
+        int building = m_buildingRects.FirstContaining(interActX, interActY);
+        if (building >= 0)
+        {
+            target = m_buildings[building];
+        }
+        bool didInteract = false;
+        if (target)
+        {
+            Interaction interaction = { actor.heldObject, IsAudible(actor), target, tileX, tileY };
+            didInteract = m_interactions.Run(HeldType(actor.heldObject), m_world.GetComponent<Interactable>(target.value()).type, interaction);
+        }
+        if (!didInteract)
+        {
+            if (!actor.heldObject)
+            {
+                IteratePlaced([&](Pickup& pickup)
+                {
+                    if (!actor.heldObject && pickup.x == tileX && pickup.y == tileY)
+                    {
+                        actor.heldObject = pickup.entity;
+                    }
+                });
+                Crop* ripe = nullptr;
+                if (!actor.heldObject)
+                {
+                    m_world.IterateComps<Crop>([&](Crop& crop)
+                    {
+                        if (!ripe && crop.tileX == tileX && crop.tileY == tileY && crop.stage == 4)
                         {
-                            auto& waterCan = m_world.GetComponent<WateringCan>(obj);
-                            auto didWater = false;
-                            if (tile->index == 1)
-                            {
-                                tile->index = 2;
-                                waterCan.left--;
-                                didWater = true;
-                            }
-                            else
-                            {
-                                m_world.IterateComps<Crop>([&](Crop& crop)
-                                {
-                                    if (crop.tileX != tileX || crop.tileY != tileY)
-                                    {
-                                        return;
-                                    }
-                                    if (!crop.watered)
-                                    {
-                                        crop.watered = true;
-                                        waterCan.left--;
-                                        tile->index++;
-                                        didWater = true;
-                                    }
-                                });
-                            }
-                            if (waterCan.left <= 0)
-                            {
-                                m_world.Delete(obj);
-                                player.heldObject = std::nullopt;
-                            }
-                            tako::Audio::Play(didWater ? *m_clipWater : *m_clipError);
+                            ripe = &crop;
                         }
-                        else if(m_world.HasComponent<SeedBag>(obj))
+                    });
+                }
+                if (actor.heldObject)
+                {
+                    m_items.Hold(m_world, actor.heldObject.value());
+                    Emit(EventType::Pickup, IsAudible(actor));
+                }
+                else if (ripe)
+                {
+                    ripe->stage = -69;
+                    m_level.GetTile(tileX, tileY).value()->index = ripe->watered ? 2 : 1;
+                    ripe->watered = true;
+                    Parsnip snip;
+                    snip.harvestDay = m_currentDay;
+                    actor.heldObject = m_items.Take(m_world, m_assets->parsnip, snip);
+                    Emit(EventType::Harvest, IsAudible(actor));
+                    Burst(HARVEST_BURST, tileX, tileY);
+                }
+                else
+                {
+                    Emit(EventType::Error, IsAudible(actor));
+                }
+            }
+            else
+            {
+                // Find out if tile is free
+                auto blocked = ((int) m_playerSpawn.x) / 16 == tileX && ((int) m_playerSpawn.y) / 16 == tileY;
+                IteratePlaced([&](Pickup& pickup)
+                {
+                    if (blocked)
+                    {
+                        return;
+                    }
+                    if (pickup.x != tileX || pickup.y != tileY)
+                    {
+                        return;
+                    }
+
+                    blocked = true;
+                });
+                if (!blocked)
+                {
+                    m_world.IterateComps<Crop>([&](Crop& crop)
+                    {
+                        if (blocked)
                         {
-                            if (tile->index == 1 || tile->index == 2)
-                            {
-                                auto blocked = false;
-                                m_world.IterateComps<Pickup>([&](Pickup& pickup)
-                                {
-                                    if (tileX == pickup.x && tileY == pickup.y)
-                                    {
-                                        blocked = true;
-                                    }
-                                });
-                                if (!blocked)
-                                {
-                                    CreateCrop(tileX, tileY);
-                                    tako::Audio::Play(*m_clipSow);
-                                }
-                                else
-                                {
-                                    tako::Audio::Play(*m_clipError);
-                                }
-                            }
-                            else
-                            {
-                                tako::Audio::Play(*m_clipError);
-                            }
+                            return;
                         }
-                        else
+                        if (crop.tileX != tileX || crop.tileY != tileY || crop.stage <= 0)
                         {
-                            tako::Audio::Play(*m_clipError);
+                            return;
                         }
+
+                        blocked = true;
+                    });
+                }
+                blocked = blocked || m_buildingRects.FirstContaining(interActX, interActY) >= 0;
+
+                if (!blocked)
+                {
+                    auto obj = actor.heldObject.value();
+                    m_items.Place(m_world, obj, tileX, tileY);
+                    Position& p = m_world.GetComponent<Position>(obj);
+                    actor.heldObject = std::nullopt;
+                    Rect placed(p.x, p.y, 16, 16);
+                    Rect self(pos.x, pos.y, rigid.size.x, rigid.size.y);
+                    if (actor.facing.x && Rect::OverlapX(self, placed))
+                    {
+                        pos.x += tako::mathf::sign(pos.x - p.x) * (16 - tako::mathf::abs(pos.x - p.x));
                     }
+                    if (actor.facing.y && Rect::OverlapY(self, placed))
+                    {
+                        pos.y += tako::mathf::sign(pos.y - p.y) * (16 - tako::mathf::abs(pos.y - p.y));
+                    }
+                    Emit(EventType::Drop, IsAudible(actor));
                 }
                 else
                 {
-                    tako::Audio::Play(*m_clipError);
+                    Emit(EventType::Error, IsAudible(actor));
+                }
+            }
+        }
+    }
+
+    template<class Actor>
+    void UseHeld(Position& pos, Actor& actor)
+    {
+        float interActX = pos.x + actor.facing.x * 12;
+        float interActY = pos.y + actor.facing.y * 12;
+        int tileX = ((int) interActX) / 16;
+        int tileY = ((int) interActY) / 16;
+        if (!actor.heldObject)
+        {
+            Emit(EventType::Error, IsAudible(actor));
+            return;
+        }
+        if (!m_level.GetTile(tileX, tileY))
+        {
+            return;
+        }
+        Interaction interaction = { actor.heldObject, IsAudible(actor), std::nullopt, tileX, tileY };
+        if (!m_interactions.Run(HeldType(actor.heldObject), TargetType::Ground, interaction))
+        {
+            Emit(EventType::Error, IsAudible(actor));
+        }
+    }
+
+    ItemType HeldType(const std::optional<tako::Entity>& held)
+    {
+        return held ? m_world.GetComponent<Item>(held.value()).type : ItemType::None;
+    }
+
+    void RegisterInteractions()
+    {
+        m_interactions.Register(ItemType::None, TargetType::Well, [&](Interaction& interaction)
+        {
+            interaction.held = m_items.Take(m_world, m_assets->waterCan, WateringCan());
+            Emit(EventType::Fill, interaction.audible);
+            return true;
+        });
+        m_interactions.Register(ItemType::WateringCan, TargetType::Well, [&](Interaction& interaction)
+        {
+            m_world.GetComponent<WateringCan>(interaction.held.value()) = WateringCan();
+            Emit(EventType::Fill, interaction.audible);
+            return true;
+        });
+        m_interactions.Register(ItemType::Parsnip, TargetType::TransportBox, [&](Interaction& interaction)
+        {
+            auto held = interaction.held.value();
+            if (m_world.GetComponent<Parsnip>(held).harvestDay < m_currentDay)
+            {
+                m_parsnipCountSafe++;
+            }
+            m_items.Release(m_world, held);
+            interaction.held = std::nullopt;
+            m_parsnipCount++;
+            Emit(EventType::Deliver, interaction.audible, m_parsnipCount);
+            Burst(DELIVER_BURST, interaction.tileX, interaction.tileY);
+            return true;
+        });
+        m_interactions.Register(ItemType::WateringCan, TargetType::Ground, [&](Interaction& interaction)
+        {
+            auto obj = interaction.held.value();
+            auto tile = m_level.GetTile(interaction.tileX, interaction.tileY).value();
+            auto& waterCan = m_world.GetComponent<WateringCan>(obj);
+            auto didWater = false;
+            if (tile->index == 1)
+            {
+                tile->index = 2;
+                waterCan.left--;
+                didWater = true;
+            }
+            else
+            {
+                m_world.IterateComps<Crop>([&](Crop& crop)
+                {
+                    if (crop.tileX != interaction.tileX || crop.tileY != interaction.tileY)
+                    {
+                        return;
+                    }
+                    if (!crop.watered)
+                    {
+                        crop.watered = true;
+                        waterCan.left--;
+                        tile->index++;
+                        didWater = true;
+                    }
+                });
+            }
+            if (waterCan.left <= 0)
+            {
+                m_items.Release(m_world, obj);
+                interaction.held = std::nullopt;
+            }
+            if (didWater)
+            {
+                Emit(EventType::Water, interaction.audible);
+                Burst(WATER_BURST, interaction.tileX, interaction.tileY);
+            }
+            return didWater;
+        });
+        m_interactions.Register(ItemType::SeedBag, TargetType::Ground, [&](Interaction& interaction)
+        {
+            auto tile = m_level.GetTile(interaction.tileX, interaction.tileY).value();
+            if (tile->index != 1 && tile->index != 2)
+            {
+                return false;
+            }
+            auto blocked = false;
+            IteratePlaced([&](Pickup& pickup)
+            {
+                if (interaction.tileX == pickup.x && interaction.tileY == pickup.y)
+                {
+                    blocked = true;
                 }
+            });
+            if (blocked)
+            {
+                return false;
             }
+            CreateCrop(interaction.tileX, interaction.tileY);
+            Emit(EventType::Sow, interaction.audible);
+            return true;
         });
+    }
+
+    void InitFields()
+    {
+        // Buildings only come and go with the level, the same places rebuild the fields
+        m_buildings.clear();
+        m_buildingRects.Clear();
+        m_wellTiles.clear();
+        m_boxTiles.clear();
+        m_world.IterateHandle<Position, Interactable>([&](tako::EntityHandle handle)
+        {
+            auto& interactable = m_world.GetComponent<Interactable>(handle.id);
+            auto& iPos = m_world.GetComponent<Position>(handle.id);
+            m_buildings.push_back(handle.id);
+            m_buildingRects.Add(Rect(iPos.x, iPos.y, interactable.w, interactable.h));
+            auto tiles = Farmhands::TilesCovered(Rect(iPos.x, iPos.y, interactable.w, interactable.h));
+            if (interactable.type == TargetType::Well)
+            {
+                m_wellTiles.insert(m_wellTiles.end(), tiles.begin(), tiles.end());
+            }
+            else if (interactable.type == TargetType::TransportBox)
+            {
+                m_boxTiles.insert(m_boxTiles.end(), tiles.begin(), tiles.end());
+            }
+        });
+        m_level.TakeSolidChanges();
+        auto chunks = m_level.ResidentChunks();
+        m_wellField.Init(&m_level, chunks);
+        m_wellField.SetTargets(m_wellTiles);
+        m_boxField.Init(&m_level, chunks);
+        m_boxField.SetTargets(m_boxTiles);
+        m_dryField.Init(&m_level, chunks);
+        m_dryField.SetTargets({});
+        m_dryTargets.clear();
+    }
+
+    // Brings the fields up to date with this frame's dry crops and any tiles that changed solidity
+    void SyncFields(const FarmTargets& targets)
+    {
+        for (auto [x, y] : m_level.TakeSolidChanges())
+        {
+            m_wellField.TileChanged(x, y);
+            m_boxField.TileChanged(x, y);
+            m_dryField.TileChanged(x, y);
+        }
+
+        std::map<TileCoord, int> dry;
+        for (auto& tile : targets.unwatered)
+        {
+            dry[tile]++;
+        }
+        for (auto& [tile, count] : m_dryTargets)
+        {
+            auto it = dry.find(tile);
+            for (int i = it == dry.end() ? 0 : it->second; i < count; i++)
+            {
+                m_dryField.RemoveTarget(tile.first, tile.second);
+            }
+        }
+        for (auto& [tile, count] : dry)
+        {
+            auto it = m_dryTargets.find(tile);
+            for (int i = it == m_dryTargets.end() ? 0 : it->second; i < count; i++)
+            {
+                m_dryField.AddTarget(tile.first, tile.second);
+            }
+        }
+        m_dryTargets = std::move(dry);
+    }
+
+    const FlowField* FieldFor(FarmhandTask task)
+    {
+        switch (task)
+        {
+            case FarmhandTask::FetchWater:
+                return &m_wellField;
+            case FarmhandTask::Deliver:
+                return &m_boxField;
+            case FarmhandTask::Water:
+                return &m_dryField;
+            default:
+                return nullptr;
+        }
+    }
+
+    void UpdateFarmhands(float dt)
+    {
+        // Planning and work change the world, so farmhands take turns in iteration order after the iteration
+        auto targets = GatherFarmTargets();
+        SyncFields(targets);
+        std::vector<tako::Entity> hands;
+        m_world.IterateHandle<Position, RigidBody, Farmhand>([&](tako::EntityHandle handle)
+        {
+            hands.push_back(handle.id);
+        });
+        for (auto entity : hands)
+        {
+            auto& hand = m_world.GetComponent<Farmhand>(entity);
+            auto& pos = m_world.GetComponent<Position>(entity);
+            if (hand.task == FarmhandTask::Idle)
+            {
+                PlanFarmhand(targets, pos, m_world.GetComponent<RigidBody>(entity), hand);
+            }
+            else if (Farmhands::Arrived(pos.AsVec(), hand, FieldFor(hand.task)))
+            {
+                WorkFarmhand(entity, hand);
+            }
+        }
+
+        struct Mover
+        {
+            Position* pos;
+            RigidBody* rigid;
+            Farmhand* hand;
+            SpriteRenderer* sprite;
+            AnimatedSprite* anim;
+            size_t body;
+        };
+        std::vector<Mover> movers;
+        RectBatch bodies;
+        m_world.IterateComps<Position, RigidBody>([&](Position& pos, RigidBody& rigid)
+        {
+            if (rigid.enabled)
+            {
+                bodies.Add({pos.AsVec(), rigid.size});
+            }
+        });
+        size_t body = 0;
+        m_world.IterateComps<Position, RigidBody>([&](Position& pos, RigidBody& rigid)
+        {
+            if (!rigid.enabled)
+            {
+                return;
+            }
+            if (m_world.HasComponent<Farmhand>(rigid.entity))
+            {
+                movers.push_back({&pos, &rigid, &m_world.GetComponent<Farmhand>(rigid.entity),
+                                  &m_world.GetComponent<SpriteRenderer>(rigid.entity), &m_world.GetComponent<AnimatedSprite>(rigid.entity), body});
+            }
+            body++;
+        });
+
+        // Sweeping against the level only reads, so every farmhand proposes a move in parallel
+        Parallel::For(movers.size(), 32, [&](int begin, int end)
+        {
+            for (int i = begin; i < end; i++)
+            {
+                auto& m = movers[i];
+                auto from = m.pos->AsVec();
+                auto field = FieldFor(m.hand->task);
+                if (m.hand->task == FarmhandTask::Idle || Farmhands::Arrived(from, *m.hand, field))
+                {
+                    m.hand->proposed = from;
+                    continue;
+                }
+                m.hand->proposed = Physics::SweepLevel(m_level, from, m.rigid->size, Farmhands::Steer(from, *m.hand, field, dt));
+            }
+        });
+
+        // Bodies are resolved one after another in the same order every run, earlier farmhands win a contested spot
+        for (auto& m : movers)
+        {
+            auto from = m.pos->AsVec();
+            auto to = m.hand->proposed;
+            auto size = m.rigid->size;
+            auto blocked = [&](tako::Vector2 p)
+            {
+                Rect current(from, size);
+                return bodies.FindOverlap(Rect(p, size), [&](size_t i)
+                {
+                    return i != m.body && !bodies.Overlaps(i, current);
+                }) >= 0;
+            };
+            if (to != from && blocked(to))
+            {
+                tako::Vector2 slideX(to.x, from.y);
+                tako::Vector2 slideY(from.x, to.y);
+                if (!blocked(slideX) && !m_level.Overlap({slideX, size}))
+                {
+                    to = slideX;
+                }
+                else if (!blocked(slideY) && !m_level.Overlap({slideY, size}))
+                {
+                    to = slideY;
+                }
+                else
+                {
+                    to = from;
+                }
+            }
+            *m.pos = to;
+            bodies.Set(m.body, Rect(to, size));
+
+            auto moved = to - from;
+            bool moving = moved.magnitude() > 0.0001f;
+            bool changedFacing = false;
+            if (moving)
+            {
+                tako::Vector2 newFace = tako::mathf::abs(moved.x) >= tako::mathf::abs(moved.y)
+                    ? tako::Vector2(tako::mathf::sign(moved.x), 0)
+                    : tako::Vector2(0, tako::mathf::sign(moved.y));
+                changedFacing = m.hand->facing != newFace;
+                m.hand->facing = newFace;
+                if (changedFacing && newFace.x != 0)
+                {
+                    m.sprite->size.x = newFace.x * tako::mathf::abs(m.sprite->size.x);
+                }
+            }
+            if ((!m.hand->wasMoving || changedFacing) && moving)
+            {
+                m.anim->SetAnim(0.15f, &m_assets->playerSprites[GetIdleIndex(m.hand->facing)], 4);
+                m.sprite->sprite = m_assets->playerSprites[GetIdleIndex(m.hand->facing)+1];
+                m.anim->passed = 0;
+            }
+            else if (m.hand->wasMoving && !moving)
+            {
+                m.anim->SetStatic(&m_assets->playerSprites[GetIdleIndex(m.hand->facing)]);
+            }
+            m.hand->wasMoving = moving;
+
+            if (m.hand->task != FarmhandTask::Idle)
+            {
+                m.hand->sidestep -= dt;
+                if (m.hand->sidestep <= 0 && !Farmhands::Arrived(to, *m.hand, FieldFor(m.hand->task)) && moved.magnitude() < Farmhands::SPEED * dt * 0.1f)
+                {
+                    m.hand->sidestep = Farmhands::SIDESTEP;
+                    m.hand->sidestepLeft = !m.hand->sidestepLeft;
+                }
+                m.hand->patience -= dt;
+                if (m.hand->patience <= 0)
+                {
+                    m.hand->task = FarmhandTask::Idle;
+                }
+            }
+        }
+    }
+
+    FarmTargets GatherFarmTargets()
+    {
+        FarmTargets targets;
+        m_world.IterateComps<Crop>([&](Crop& crop)
+        {
+            if (crop.stage <= 0)
+            {
+                return;
+            }
+            if (!crop.watered)
+            {
+                targets.unwatered.emplace_back(crop.tileX, crop.tileY);
+            }
+            if (crop.stage == 4)
+            {
+                targets.ripe.emplace_back(crop.tileX, crop.tileY);
+            }
+        });
+        IteratePlaced([&](Pickup& pickup)
+        {
+            targets.occupied.emplace(pickup.x, pickup.y);
+            if (m_world.GetComponent<Item>(pickup.entity).type == ItemType::SeedBag)
+            {
+                targets.seedBags.emplace_back(pickup.x, pickup.y);
+            }
+        });
+        m_world.IterateComps<Farmhand>([&](Farmhand& hand)
+        {
+            if (hand.task == FarmhandTask::Idle || hand.task == FarmhandTask::Rest || FieldFor(hand.task))
+            {
+                return;
+            }
+            targets.occupied.emplace(hand.standX, hand.standY);
+            targets.reserved.emplace(hand.targetX, hand.targetY);
+        });
+
+        return targets;
+    }
+
+    void PlanFarmhand(FarmTargets& targets, Position& pos, RigidBody& rigid, Farmhand& hand)
+    {
+        auto at = pos.AsVec();
+        auto task = FarmhandTask::Idle;
+        std::vector<TileCoord> cells;
+        auto pickTile = [&](const std::vector<TileCoord>& tiles, FarmhandTask onFound)
+        {
+            auto nearest = Farmhands::Nearest(tiles, targets.reserved, at);
+            if (nearest)
+            {
+                cells = { tiles[nearest.value()] };
+                task = onFound;
+            }
+            return nearest.has_value();
+        };
+        auto [tileX, tileY] = Farmhands::TileOf(at);
+        auto follow = [&](FarmhandTask onReachable)
+        {
+            bool reachable = FieldFor(onReachable)->Distance(tileX, tileY) != FlowField::UNREACHABLE;
+            if (reachable)
+            {
+                task = onReachable;
+            }
+            return reachable;
+        };
+
+        if (!hand.heldObject)
+        {
+            pickTile(targets.ripe, FarmhandTask::Harvest) ||
+            (!targets.unwatered.empty() && follow(FarmhandTask::FetchWater)) ||
+            (targets.unwatered.empty() && pickTile(targets.seedBags, FarmhandTask::FetchSeeds));
+        }
+        else
+        {
+            auto held = HeldType(hand.heldObject);
+            if (held == ItemType::Parsnip)
+            {
+                follow(FarmhandTask::Deliver);
+            }
+            else if (held == ItemType::WateringCan)
+            {
+                if (!follow(FarmhandTask::Water) && !targets.ripe.empty())
+                {
+                    task = FarmhandTask::Drop;
+                }
+            }
+            else if (held == ItemType::SeedBag)
+            {
+                // Only sow what the others can keep watered
+                auto sow = Farmhands::FindSowTile(m_level, targets, at);
+                if (!targets.unwatered.empty() || !targets.ripe.empty())
+                {
+                    task = FarmhandTask::Drop;
+                }
+                else if (sow)
+                {
+                    cells = { sow.value() };
+                    task = FarmhandTask::Sow;
+                }
+            }
+        }
+
+        if (task == FarmhandTask::Drop)
+        {
+            // Put it down right here, trying every side until a tile is free
+            constexpr std::array<tako::Vector2, 4> sides = {{{0, -1}, {1, 0}, {0, 1}, {-1, 0}}};
+            for (auto side : sides)
+            {
+                if (!hand.heldObject)
+                {
+                    break;
+                }
+                hand.facing = side;
+                PickupDrop(pos, rigid, hand);
+            }
+            return;
+        }
+        if (task == FarmhandTask::Idle)
+        {
+            // Nothing to do, get out of the way of the others
+            auto [homeX, homeY] = Farmhands::TileOf(hand.home);
+            hand.standX = hand.targetX = homeX;
+            hand.standY = hand.targetY = homeY;
+            hand.workFacing = { 0, -1 };
+            if (!Farmhands::Arrived(at, hand, nullptr))
+            {
+                hand.task = FarmhandTask::Rest;
+                hand.patience = Farmhands::PATIENCE;
+            }
+            return;
+        }
+        hand.patience = Farmhands::PATIENCE;
+        if (FieldFor(task))
+        {
+            hand.task = task;
+            return;
+        }
+        if (!Farmhands::AssignStand(m_level, targets, cells, at, hand))
+        {
+            return;
+        }
+
+        hand.task = task;
+        targets.occupied.emplace(hand.standX, hand.standY);
+        targets.reserved.emplace(hand.targetX, hand.targetY);
+    }
+
+    void WorkFarmhand(tako::Entity entity, Farmhand& hand)
+    {
+        auto& pos = m_world.GetComponent<Position>(entity);
+        if (auto field = FieldFor(hand.task))
+        {
+            Farmhands::FaceTarget(pos.AsVec(), hand, *field);
+        }
+        hand.facing = hand.workFacing;
+        if (hand.facing.x != 0)
+        {
+            auto& sprite = m_world.GetComponent<SpriteRenderer>(entity);
+            sprite.size.x = hand.facing.x * tako::mathf::abs(sprite.size.x);
+        }
+        m_world.GetComponent<AnimatedSprite>(entity).SetStatic(&m_assets->playerSprites[GetIdleIndex(hand.facing)]);
+
+        if (hand.task == FarmhandTask::Water || hand.task == FarmhandTask::Sow)
+        {
+            UseHeld(pos, hand);
+        }
+        else if (hand.task != FarmhandTask::Rest)
+        {
+            PickupDrop(pos, m_world.GetComponent<RigidBody>(entity), hand);
+        }
+        hand.task = FarmhandTask::Idle;
+    }
+
+    // The bot walks and works like a farmhand whose tasks come from Bot::Choose, pressing the same controls as the keys
+    Controls BotControls(float dt)
+    {
+        Controls controls;
+        std::optional<tako::Entity> entity;
+        m_world.IterateHandle<Position, Player>([&](tako::EntityHandle handle)
+        {
+            if (m_world.GetComponent<Player>(handle.id).slot == 0)
+            {
+                entity = handle.id;
+            }
+        });
+        if (!entity)
+        {
+            return controls;
+        }
+        auto at = m_world.GetComponent<Position>(entity.value()).AsVec();
+        auto& player = m_world.GetComponent<Player>(entity.value());
+        auto& hand = m_botHand;
+        // A new or rewound day puts the player back at the spawn
+        if (m_dayTimeLeft > m_botDayTime)
+        {
+            hand.task = FarmhandTask::Idle;
+            m_botWait = 0;
+        }
+        m_botDayTime = m_dayTimeLeft;
+        if (m_botWait > 0)
+        {
+            m_botWait -= dt;
+            return controls;
+        }
+        if (hand.task == FarmhandTask::Idle)
+        {
+            PlanBot(at, player, controls);
+            return controls;
+        }
+
+        // Every side in turn until one is free, then off to the closest free dirt
+        constexpr std::array<tako::Vector2, 4> sides = {{{0, -1}, {1, 0}, {0, 1}, {-1, 0}}};
+        if (hand.task == FarmhandTask::Drop && m_botDropSide <= sides.size())
+        {
+            if (!player.heldObject)
+            {
+                hand.task = FarmhandTask::Idle;
+            }
+            else if (m_botDropSide < sides.size())
+            {
+                controls.move = sides[m_botDropSide++] * 0.01f;
+                controls.pickup = true;
+            }
+            else
+            {
+                auto targets = GatherFarmTargets();
+                auto spot = Farmhands::FindSowTile(m_level, targets, at);
+                m_botDropSide++;
+                m_botField = nullptr;
+                if (!spot || !Farmhands::AssignStand(m_level, targets, { spot.value() }, at, hand))
+                {
+                    hand.task = FarmhandTask::Idle;
+                    m_botWait = 0.25f;
+                }
+            }
+            return controls;
+        }
+        auto field = m_botField;
+        if (Farmhands::Arrived(at, hand, field))
+        {
+            if (field)
+            {
+                Farmhands::FaceTarget(at, hand, *field);
+            }
+            // Barely pushing the stick turns the player without leaving the tile
+            controls.move = hand.workFacing * 0.01f;
+            controls.use = hand.task == FarmhandTask::Water || hand.task == FarmhandTask::Sow;
+            controls.pickup = !controls.use;
+            hand.task = FarmhandTask::Idle;
+            return controls;
+        }
+        controls.move = Farmhands::Steer(at, hand, field, dt) / (Farmhands::SPEED * dt);
+
+        hand.sidestep -= dt;
+        if (hand.sidestep <= 0 && (at - m_botLast).magnitude() < Farmhands::SPEED * dt * 0.1f)
+        {
+            hand.sidestep = Farmhands::SIDESTEP;
+            hand.sidestepLeft = !hand.sidestepLeft;
+        }
+        m_botLast = at;
+        hand.patience -= dt;
+        if (hand.patience <= 0)
+        {
+            hand.task = FarmhandTask::Idle;
+        }
+        return controls;
+    }
+
+    void PlanBot(tako::Vector2 at, const Player& player, Controls& controls)
+    {
+        auto& hand = m_botHand;
+        auto targets = GatherFarmTargets();
+        auto goal = Bot::Choose(GatherPlanState(at, player, targets), m_botRollouts, m_botSeed++);
+        hand.patience = Farmhands::PATIENCE;
+        hand.sidestep = Farmhands::SIDESTEP;
+        m_botLast = at;
+        auto task = FarmhandTask::Idle;
+        std::vector<TileCoord> cells;
+        auto pickTile = [&](const std::vector<TileCoord>& tiles, FarmhandTask onFound)
+        {
+            if (auto nearest = Farmhands::Nearest(tiles, targets.reserved, at))
+            {
+                cells = { tiles[nearest.value()] };
+                task = onFound;
+            }
+        };
+        switch (goal)
+        {
+            case Bot::Goal::Harvest:
+                pickTile(targets.ripe, FarmhandTask::Harvest);
+                break;
+            case Bot::Goal::FetchSeeds:
+                pickTile(targets.seedBags, FarmhandTask::FetchSeeds);
+                break;
+            case Bot::Goal::Sow:
+                if (auto sow = Farmhands::FindSowTile(m_level, targets, at))
+                {
+                    cells = { sow.value() };
+                    task = FarmhandTask::Sow;
+                }
+                break;
+            case Bot::Goal::Water:
+                // Walks to a crop rather than down the dry field, the player may be standing on one of its targets
+                pickTile(targets.unwatered, FarmhandTask::Water);
+                break;
+            case Bot::Goal::FetchWater:
+                task = FarmhandTask::FetchWater;
+                break;
+            case Bot::Goal::Deliver:
+                task = FarmhandTask::Deliver;
+                break;
+            case Bot::Goal::Drop:
+                m_botDropSide = 0;
+                hand.task = FarmhandTask::Drop;
+                return;
+            default:
+                // Waits out the rest of the day
+                controls.skipDay = true;
+                m_botWait = 1;
+                return;
+        }
 
-        if (m_dayTimeLeft > 3 && (input->GetKeyDown(tako::Key::Enter) || input->GetKeyDown(tako::Key::Gamepad_Start)))
+        // Single targets get a field of their own, a straight walk gets stuck on the first fence
+        auto [tileX, tileY] = Farmhands::TileOf(at);
+        m_botField = FieldFor(task);
+        if (!cells.empty())
         {
-            m_dayTimeLeft = 3;
+            m_botPath.Init(&m_level, m_level.ResidentChunks());
+            m_botPath.SetTargets(cells);
+            m_botField = &m_botPath;
         }
-
-        m_dayTimeLeft -= dt;
-        if (m_dayTimeLeft <= 0)
+        if (m_botField && m_botField->Distance(tileX, tileY) != FlowField::UNREACHABLE && m_botField->Distance(tileX, tileY) > 0)
         {
-            PassDay();
+            hand.task = task;
         }
-        int dayLeft = std::ceil(m_dayTimeLeft);
-        if (dayLeft != m_dayTimeLeftPrev && dayLeft <= 10)
+        else if (!cells.empty() && Farmhands::AssignStand(m_level, targets, cells, at, hand))
         {
-            tako::Audio::Play(*m_clipTick);
+            // Standing on the target, the tile next to it is a step away
+            m_botField = nullptr;
+            hand.task = task;
         }
-        RerenderText(m_dayTimeLeftText, m_drawer, m_font, (dayLeft < 10 ? " " : "") + std::to_string(dayLeft));
-        m_dayTimeLeftPrev = dayLeft;
-
+        else
+        {
+            // Nothing reachable, think again shortly
+            m_botWait = 0.25f;
+        }
+    }
 
-        m_world.IterateComps<SpriteRenderer, AnimatedSprite>([&](SpriteRenderer& sprite, AnimatedSprite& anim)
+    // The farm around the player as the bot's rollouts see it, what farmhands are already working on is theirs
+    Bot::PlanState GatherPlanState(tako::Vector2 at, const Player& player, const FarmTargets& targets)
+    {
+        Bot::PlanState state;
+        state.player = Farmhands::TileOf(at);
+        state.spawn = Farmhands::TileOf(m_playerSpawn);
+        auto near = [&](int x, int y)
         {
-            anim.passed += dt;
-            if (anim.passed >= anim.duration)
+            return std::abs(x - state.player.first) <= Bot::WINDOW && std::abs(y - state.player.second) <= Bot::WINDOW;
+        };
+        std::set<TileCoord> taken;
+        m_world.IterateComps<Crop>([&](Crop& crop)
+        {
+            taken.emplace(crop.tileX, crop.tileY);
+            if (crop.stage <= 0 || !near(crop.tileX, crop.tileY) || targets.reserved.count({crop.tileX, crop.tileY}))
             {
-                int index = 0;
-                while (index < anim.frames && anim.sprites[index] != sprite.sprite)
-                {
-                    index++;
-                }
-                index++;
-                if (index >= anim.frames)
-                {
-                    sprite.sprite = anim.sprites[0];
-                }
-                else
+                return;
+            }
+            int dayStart = m_currentDay > 0 ? crop.stageHistory[m_currentDay - 1] : 0;
+            state.crops.push_back({{crop.tileX, crop.tileY}, crop.stage, dayStart, crop.watered});
+        });
+        IteratePlaced([&](Pickup& pickup)
+        {
+            taken.emplace(pickup.x, pickup.y);
+            bool free = near(pickup.x, pickup.y) && !targets.reserved.count({pickup.x, pickup.y});
+            if (free && m_world.GetComponent<Item>(pickup.entity).type == ItemType::SeedBag)
+            {
+                state.seedBags.emplace_back(pickup.x, pickup.y);
+            }
+        });
+        for (int y = state.player.second - Bot::WINDOW; y <= state.player.second + Bot::WINDOW; y++)
+        {
+            for (int x = state.player.first - Bot::WINDOW; x <= state.player.first + Bot::WINDOW; x++)
+            {
+                auto tile = m_level.GetTile(x, y);
+                if (tile && (tile.value()->index == 1 || tile.value()->index == 2) && !taken.count({x, y}))
                 {
-                    sprite.sprite = anim.sprites[index];
+                    state.soil.emplace_back(x, y);
                 }
-                anim.passed = 0;
             }
-        });
+        }
+        state.wells = m_wellTiles;
+        state.boxes = m_boxTiles;
+
+        state.held = HeldType(player.heldObject);
+        if (state.held == ItemType::WateringCan)
+        {
+            state.canLeft = m_world.GetComponent<WateringCan>(player.heldObject.value()).left;
+        }
+        else if (state.held == ItemType::Parsnip)
+        {
+            state.heldToday = m_world.GetComponent<Parsnip>(player.heldObject.value()).harvestDay == m_currentDay;
+        }
+        state.timeLeft = m_dayTimeLeft;
+        state.dayLength = DAY_LENGTH;
+        state.day = m_currentDay;
+        state.parsnips = m_parsnipCount;
+        state.parsnipsToday = m_parsnipCount - m_parsnipCountPrev - m_parsnipCountSafe;
+        return state;
     }
 
     void PassDay()
     {
-        bool allWatered = true;
+        auto result = SimulateDay();
+        if (result == DayResult::Finished)
+        {
+            Emit(EventType::DayPassed);
+            m_dayTimeLeft = 0;
+            m_screen = SCREEN::EndScreen;
+            return;
+        }
+        Emit(result == DayResult::Grown ? EventType::DayPassed : EventType::DayRewound);
+        ResetActors();
+        m_dayTimeLeft = DAY_LENGTH;
+    }
+
+    // Skips days without ticking any frames, with waterAll every crop is watered before its day ends.
+    // Returns how many days actually ended, fewer when the game finishes first
+    int FastForward(int days, bool waterAll)
+    {
+        int passed = 0;
+        while (passed < days && m_screen == SCREEN::Game)
+        {
+            if (waterAll)
+            {
+                WaterAllCrops();
+            }
+            auto result = SimulateDay();
+            passed++;
+            Emit(result == DayResult::Rewound ? EventType::DayRewound : EventType::DayPassed, false);
+            if (result == DayResult::Finished)
+            {
+                m_dayTimeLeft = 0;
+                m_screen = SCREEN::EndScreen;
+                return passed;
+            }
+        }
+        ResetActors();
+        m_dayTimeLeft = DAY_LENGTH;
+        return passed;
+    }
+
+    void WaterAllCrops()
+    {
         m_world.IterateComps<Crop>([&](Crop& crop)
         {
-            if (!crop.watered)
+            if (crop.stage > 0 && !crop.watered)
             {
-                allWatered = false;
+                crop.watered = true;
+                m_level.GetTile(crop.tileX, crop.tileY).value()->index++;
             }
         });
-        m_world.IterateHandle<Crop>([&](tako::EntityHandle handle)
+    }
+
+    // The rules ending a day: crops grow when all of them were watered, otherwise the day is rewound
+    DayResult SimulateDay()
+    {
+        std::vector<Crop*> crops;
+        m_world.IterateComps<Crop>([&](Crop& crop)
         {
-            Crop& crop = m_world.GetComponent<Crop>(handle.id);
-            if (allWatered)
+            crops.push_back(&crop);
+        });
+        std::atomic<bool> anyDry = false;
+        Parallel::For(crops.size(), 1024, [&](int begin, int end)
+        {
+            for (int i = begin; i < end && !anyDry; i++)
             {
-                if (crop.stage < 4)
+                if (!crops[i]->watered)
                 {
-                    crop.stage++;
+                    anyDry = true;
                 }
-                crop.stageHistory[m_currentDay] = crop.stage;
             }
-            else
+        });
+        bool allWatered = !anyDry;
+        Parallel::For(crops.size(), 1024, [&](int begin, int end)
+        {
+            for (int i = begin; i < end; i++)
             {
-                crop.stage = crop.stageHistory[m_currentDay - 1];
+                Crop& crop = *crops[i];
+                if (allWatered)
+                {
+                    if (crop.stage < 4)
+                    {
+                        crop.stage++;
+                    }
+                    crop.stageHistory[m_currentDay] = crop.stage;
+                }
+                else
+                {
+                    crop.stage = crop.stageHistory[m_currentDay - 1];
+                }
+                crop.watered = false;
             }
-            if (crop.stage > 0)
+        });
+        // Two crops can share a tile, so tiles are written in order afterwards
+        for (auto crop : crops)
+        {
+            if (crop->stage > 0)
             {
-                m_level.GetTile(crop.tileX, crop.tileY).value()->index = 1 + 2 * crop.stage;
+                m_level.GetTile(crop->tileX, crop->tileY).value()->index = 1 + 2 * crop->stage;
             }
-            crop.watered = false;
-        });
-        std::vector<tako::Entity> clearCrop;
+        }
         if (allWatered)
         {
-            tako::Audio::Play(*m_clipDay);
             if (m_currentDay == TOTAL_DAYS)
             {
-                m_dayTimeLeft = 0;
-                m_screen = SCREEN::EndScreen;
-                RenderEndText();
-                return;
+                return DayResult::Finished;
             }
             m_currentDay++;
             m_parsnipCountPrev = m_parsnipCount;
             m_parsnipCountSafe = 0;
-            RerenderText(m_currentDayText, m_drawer, m_font, "Day " + std::to_string(m_currentDay));
         }
         else
         {
-            tako::Audio::Play(*m_clipLoop);
             m_parsnipCount = m_parsnipCountPrev + m_parsnipCountSafe;
-            RerenderText(m_parsnipText, m_drawer, m_font, std::to_string(m_parsnipCount));
             m_world.IterateHandle<Parsnip>([&](tako::EntityHandle handle)
             {
-                if (m_world.GetComponent<Parsnip>(handle.id).harvestDay == m_currentDay)
+                auto state = m_world.GetComponent<Item>(handle.id).state;
+                if (state != ItemState::Stored && m_world.GetComponent<Parsnip>(handle.id).harvestDay == m_currentDay)
                 {
-                    clearCrop.push_back(handle.id);
+                    m_items.Release(m_world, handle.id);
                     m_world.IterateComps<Player>([&](Player &player)
                     {
                         if (player.heldObject && player.heldObject.value() == handle.id)
@@ -703,6 +2008,13 @@ public:
                             player.heldObject = std::nullopt;
                         }
                     });
+                    m_world.IterateComps<Farmhand>([&](Farmhand& hand)
+                    {
+                        if (hand.heldObject && hand.heldObject.value() == handle.id)
+                        {
+                            hand.heldObject = std::nullopt;
+                        }
+                    });
                 }
             });
         }
@@ -711,93 +2023,342 @@ public:
             Crop& crop = m_world.GetComponent<Crop>(handle.id);
             if (crop.stage <= 0)
             {
-                clearCrop.push_back(handle.id);
+                m_commands.Delete(handle.id);
                 if (!allWatered)
                 {
                     m_level.GetTile(crop.tileX, crop.tileY).value()->index = 1;
                 }
             }
         });
-        for (auto ent : clearCrop)
-        {
-            m_world.Delete(ent);
-        }
+        Sync();
         m_level.ResetWatered();
+        return allWatered ? DayResult::Grown : DayResult::Rewound;
+    }
+
+    // Everyone back to where they start the day
+    void ResetActors()
+    {
         for (auto [pos, player, anim]: m_world.Iter<Position, Player, AnimatedSprite>())
         {
             pos = m_playerSpawn;
             player.wasMoving = false;
             player.facing = { 0, -1 };
-            anim.SetStatic(&m_playerSprites[0]);
+            anim.SetStatic(&m_assets->playerSprites[0]);
+        }
+        for (auto [pos, hand, anim]: m_world.Iter<Position, Farmhand, AnimatedSprite>())
+        {
+            pos = hand.home;
+            hand.wasMoving = false;
+            hand.facing = { 0, -1 };
+            hand.task = FarmhandTask::Idle;
+            anim.SetStatic(&m_assets->playerSprites[0]);
         }
-        m_dayTimeLeft = DAY_LENGTH;
     }
 
 
-    void Draw(tako::PixelArtDrawer* drawer)
+    // What the world looks like at the end of this update, for Draw
+    void Capture()
     {
-        if (m_screen == SCREEN::PressAny)
+        auto& frame = m_frames.Back();
+        frame.screen = m_screen;
+        frame.tiles.clear();
+        frame.rects.clear();
+        frame.sprites.clear();
+        frame.particles.clear();
+        frame.held = nullptr;
+        frame.light = {255, 255, 255, 255};
+        if (m_screen == SCREEN::Title)
         {
-            return DrawPressAny(drawer);
+            // Generated farms only have the chunks around the spawn loaded
+            auto focus = m_level.Generated() ? m_playerSpawn : tako::Vector2(170, 180);
+            frame.camera = FitMapBound(m_level.MapBounds(), focus, m_viewSize);
+            m_level.GatherTiles({frame.camera, m_viewSize}, frame.tiles);
         }
-        if (m_screen == SCREEN::Title)
+        else if (m_screen != SCREEN::PressAny)
         {
-            return DrawTitle(drawer);
+            float colorGradient = dayTimeEasing(m_dayTimeLeft / DAY_LENGTH);
+            frame.light = tako::Color(255 * colorGradient, 255 * colorGradient, 255 * colorGradient, 255);
+            m_world.IterateComps<Position, Camera>([&](Position& pos, Camera& player)
+            {
+               frame.camera = FitMapBound(m_level.MapBounds(), pos.AsVec(), m_viewSize);
+            });
+            m_level.GatherTiles({frame.camera, m_viewSize}, frame.tiles);
+
+            m_world.IterateComps<Position, RectangleRenderer, Background>([&](Position& pos, RectangleRenderer& rect, Background& b)
+            {
+                frame.rects.push_back({pos.x - rect.size.x / 2, pos.y + rect.size.y / 2, rect.size.x, rect.size.y, rect.color});
+            });
+            m_world.IterateComps<Position, RectangleRenderer, Foreground>([&](Position& pos, RectangleRenderer& rect, Foreground& f)
+            {
+                frame.rects.push_back({pos.x - rect.size.x / 2, pos.y + rect.size.y / 2, rect.size.x, rect.size.y, rect.color});
+            });
+            auto sprite = [&](Position& pos, SpriteRenderer& sprite)
+            {
+                frame.sprites.push_back({pos.x - sprite.size.x / 2 + sprite.offset.x, pos.y + sprite.size.y / 2 + sprite.offset.y, sprite.size.x, sprite.size.y, sprite.sprite});
+            };
+            m_world.IterateComps<Position, SpriteRenderer, Background>([&](Position& pos, SpriteRenderer& renderer, Background& b)
+            {
+                sprite(pos, renderer);
+            });
+            m_world.IterateComps<Position, SpriteRenderer, Item>([&](Position& pos, SpriteRenderer& renderer, Item& item)
+            {
+                if (item.state == ItemState::Placed)
+                {
+                    sprite(pos, renderer);
+                }
+            });
+            m_world.IterateComps<Position, SpriteRenderer, Foreground>([&](Position& pos, SpriteRenderer& renderer, Foreground& f)
+            {
+                sprite(pos, renderer);
+            });
+            m_particles.Gather({frame.camera, m_viewSize}, frame.light, frame.particles);
+            m_world.IterateComps<Player, Camera>([&](Player& p, Camera& camera)
+            {
+                if (p.heldObject)
+                {
+                    frame.held = m_world.GetComponent<SpriteRenderer>(p.heldObject.value()).sprite;
+                }
+            });
         }
-        auto cameraSize = drawer->GetCameraViewSize();
-        drawer->Clear();
-        float colorGradient = dayTimeEasing(m_dayTimeLeft / DAY_LENGTH);
-        tako::Color dayLightColor(255 * colorGradient, 255 * colorGradient, 255 * colorGradient, 255);
+        frame.day = m_currentDay;
+        frame.parsnips = m_parsnipCount;
+        frame.clock = std::max(0, (int) std::ceil(m_dayTimeLeft));
+        m_frames.Publish();
+    }
 
-        m_world.IterateComps<Position, Camera>([&](Position& pos, Camera& player)
+    // What the host last sent, made into a frame the same way Capture makes one of this game's own world
+    void CaptureReplica()
+    {
+        auto& frame = m_frames.Back();
+        auto& snapshot = m_client->Latest();
+        frame.screen = m_client->Connected() ? (SCREEN) snapshot.screen : SCREEN::PressAny;
+        frame.tiles.clear();
+        frame.rects.clear();
+        frame.sprites.clear();
+        frame.particles.clear();
+        float timeLeft = snapshot.timeLeft / 16.0f;
+        frame.light = {255, 255, 255, 255};
+        if (frame.screen == SCREEN::Game || frame.screen == SCREEN::EndScreen)
         {
-           drawer->SetCameraPosition(FitMapBound(m_level.MapBounds(), pos.AsVec(), drawer->GetCameraViewSize()));
-        });
-        m_level.Draw(drawer, dayLightColor);
+            float colorGradient = dayTimeEasing(timeLeft / DAY_LENGTH);
+            frame.light = tako::Color(255 * colorGradient, 255 * colorGradient, 255 * colorGradient, 255);
+        }
+        frame.camera = {NetPixels(snapshot.cameraX), NetPixels(snapshot.cameraY)};
+        auto& area = snapshot.area;
+        for (int y = area.y1; y >= area.y0; y--)
+        {
+            for (int x = area.x0; x <= area.x1; x++)
+            {
+                int tile = snapshot.Tile(x, y);
+                if (tile > 0 && (size_t) tile <= m_assets->tileSprites.size())
+                {
+                    frame.tiles.push_back({x * 16.0f, y * 16.0f + 16, m_assets->tileSprites[tile - 1]});
+                }
+            }
+        }
+        for (int layer = 0; layer < SPRITE_LAYERS; layer++)
+        {
+            for (auto& sprite : snapshot.sprites)
+            {
+                if (sprite.layer == layer)
+                {
+                    frame.sprites.push_back({NetPixels(sprite.x), NetPixels(sprite.y), (float) sprite.w, (float) sprite.h, m_assets->SpriteAt(sprite.sprite)});
+                }
+            }
+        }
+        frame.held = m_assets->SpriteAt(snapshot.held);
+        frame.day = snapshot.day;
+        frame.parsnips = snapshot.parsnips;
+        frame.clock = (int) std::ceil(timeLeft);
+        m_frames.Publish();
+    }
+
+    // Players come and go with their clients, what they pressed counts in the next game update
+    void ServeInputs()
+    {
+        m_server->Receive(m_frame);
+        for (int slot = 1; slot < MAX_PLAYERS; slot++)
+        {
+            bool connected = m_server->Connected(slot);
+            if (connected != bool(m_players & (1 << slot)))
+            {
+                m_players ^= 1 << slot;
+                if (!connected)
+                {
+                    RemovePlayer(slot);
+                }
+                else if (m_screen == SCREEN::Game)
+                {
+                    SpawnPlayer(slot);
+                }
+            }
+            m_remoteActions[slot] = m_server->TakeActions(slot);
+        }
+    }
+
+    void ServeSnapshots()
+    {
+        for (int slot = 1; slot < MAX_PLAYERS; slot++)
+        {
+            if (m_server->Connected(slot))
+            {
+                GatherSnapshot(m_server->Prepare(slot, m_frame));
+                m_server->Send(slot, m_frame);
+            }
+        }
+        m_netSounds = 0;
+    }
 
-        m_world.IterateComps<Position, RectangleRenderer, Background>([&](Position& pos, RectangleRenderer& rect, Background& b)
+    // The client's view around its player, and nothing but the header before it has one
+    void GatherSnapshot(Snapshot& snapshot)
+    {
+        snapshot.screen = (uint8_t) m_screen;
+        snapshot.day = m_currentDay;
+        snapshot.parsnips = m_parsnipCount;
+        snapshot.timeLeft = std::max(0, (int) std::ceil(m_dayTimeLeft * 16));
+        snapshot.sounds = m_netSounds;
+        snapshot.held = 0;
+        snapshot.tiles.clear();
+        snapshot.sprites.clear();
+        std::optional<tako::Vector2> focus;
+        m_world.IterateComps<Position, Player>([&](Position& pos, Player& player)
         {
-          drawer->DrawRectangle(pos.x - rect.size.x / 2, pos.y + rect.size.y / 2, rect.size.x, rect.size.y,  rect.color);
+            if (player.slot == snapshot.slot)
+            {
+                focus = pos.AsVec();
+                if (player.heldObject)
+                {
+                    snapshot.held = m_assets->SpriteId(m_world.GetComponent<SpriteRenderer>(player.heldObject.value()).sprite);
+                }
+            }
         });
-        m_world.IterateComps<Position, RectangleRenderer, Foreground>([&](Position& pos, RectangleRenderer& rect, Foreground& f)
+        if (!focus || (m_screen != SCREEN::Game && m_screen != SCREEN::EndScreen))
+        {
+            snapshot.area = {0, 0, -1, -1};
+            return;
+        }
+        auto view = m_server->View(snapshot.slot);
+        auto camera = FitMapBound(m_level.MapBounds(), focus.value(), view);
+        snapshot.cameraX = NetUnits(camera.x);
+        snapshot.cameraY = NetUnits(camera.y);
+        auto area = m_level.VisibleArea({camera, view});
+        snapshot.area = area;
+        for (int y = area.y0; y <= area.y1; y++)
+        {
+            for (int x = area.x0; x <= area.x1; x++)
+            {
+                auto tile = m_level.GetTile(x, y);
+                snapshot.tiles.push_back(tile ? tile.value()->index : 0);
+            }
+        }
+
+        // Sprites reaching into the view by up to a tile and a half are sent along
+        Rect near(camera, view + tako::Vector2(48, 48));
+        auto add = [&](tako::EntityHandle handle, uint8_t layer)
+        {
+            auto& pos = m_world.GetComponent<Position>(handle.id);
+            if (!near.PointInside(pos.x, pos.y))
+            {
+                return;
+            }
+            auto& sprite = m_world.GetComponent<SpriteRenderer>(handle.id);
+            NetSprite net;
+            net.key = (uint32_t) handle.id;
+            net.x = NetUnits(pos.x - sprite.size.x / 2 + sprite.offset.x);
+            net.y = NetUnits(pos.y + sprite.size.y / 2 + sprite.offset.y);
+            net.w = (int32_t) sprite.size.x;
+            net.h = (int32_t) sprite.size.y;
+            net.sprite = m_assets->SpriteId(sprite.sprite);
+            net.layer = layer;
+            snapshot.sprites.push_back(net);
+        };
+        m_world.IterateHandle<Position, SpriteRenderer, Background>([&](tako::EntityHandle handle)
         {
-          drawer->DrawRectangle(pos.x - rect.size.x / 2, pos.y + rect.size.y / 2, rect.size.x, rect.size.y,  rect.color);
+            add(handle, 0);
         });
-        m_world.IterateComps<Position, SpriteRenderer, Background>([&](Position& pos, SpriteRenderer& sprite, Background& b)
+        m_world.IterateHandle<Position, SpriteRenderer, Item>([&](tako::EntityHandle handle)
         {
-           drawer->DrawSprite(pos.x - sprite.size.x / 2 + sprite.offset.x, pos.y + sprite.size.y / 2 + sprite.offset.y, sprite.size.x, sprite.size.y, sprite.sprite, dayLightColor);
+            if (m_world.GetComponent<Item>(handle.id).state == ItemState::Placed)
+            {
+                add(handle, 1);
+            }
         });
-        m_world.IterateComps<Position, SpriteRenderer, Foreground>([&](Position& pos, SpriteRenderer& sprite, Foreground& f)
+        m_world.IterateHandle<Position, SpriteRenderer, Foreground>([&](tako::EntityHandle handle)
         {
-           drawer->DrawSprite(pos.x - sprite.size.x / 2 + sprite.offset.x, pos.y + sprite.size.y / 2+ sprite.offset.y, sprite.size.x, sprite.size.y, sprite.sprite, dayLightColor);
+            add(handle, 2);
         });
+        std::sort(snapshot.sprites.begin(), snapshot.sprites.end(), [](const NetSprite& a, const NetSprite& b) { return a.key < b.key; });
+    }
+
+    // Draws the newest captured frame, with an update thread that is the frame before the update in flight
+    void Draw(Gfx::Drawer* drawer)
+    {
+        if (!m_assets->Presentable())
+        {
+            return;
+        }
+#ifdef __EMSCRIPTEN__
+        if (!m_drewFrame)
+        {
+            // The page times startup with this, see tools/first-frame.sh
+            m_drewFrame = true;
+            EM_ASM({ if (Module.onFirstFrame) Module.onFirstFrame(); });
+        }
+#endif
+        auto& frame = m_frames.Front();
+        PlaySounds();
+        Present(frame);
+        if (frame.screen == SCREEN::PressAny)
+        {
+            return DrawPressAny(drawer);
+        }
+        if (frame.screen == SCREEN::Title)
+        {
+            return DrawTitle(drawer, frame);
+        }
+        auto cameraSize = drawer->GetCameraViewSize();
+        drawer->Clear();
+        drawer->SetCameraPosition(frame.camera);
+        for (auto& tile : frame.tiles)
+        {
+            drawer->DrawSprite(tile.x, tile.y, 16, 16, tile.sprite, frame.light);
+        }
+        for (auto& rect : frame.rects)
+        {
+            drawer->DrawRectangle(rect.x, rect.y, rect.w, rect.h, rect.color);
+        }
+        for (auto& sprite : frame.sprites)
+        {
+            drawer->DrawSprite(sprite.x, sprite.y, sprite.w, sprite.h, sprite.sprite, frame.light);
+        }
+        for (auto& particle : frame.particles)
+        {
+            drawer->DrawRectangle(particle.x - particle.size / 2, particle.y + particle.size / 2, particle.size, particle.size, particle.color);
+        }
 
         constexpr auto uiBackground = tako::Color(238, 195, 154, 255);
-        if (m_screen == SCREEN::Game)
+        if (frame.screen == SCREEN::Game)
         {
             drawer->SetCameraPosition(cameraSize / 2);
 
             drawer->DrawRectangle(0, cameraSize.y, 60, 28, uiBackground);
             drawer->DrawImage(4, cameraSize.y - 4, m_currentDayText.size.x, m_currentDayText.size.y, m_currentDayText.texture, {0, 0, 0, 255});
 
-            drawer->DrawImage(3, cameraSize.y - 16, 5, 7, m_parsnipUI);
+            drawer->DrawImage(3, cameraSize.y - 16, 5, 7, m_assets->parsnipUI);
             drawer->DrawImage(11, cameraSize.y - 16, m_parsnipText.size.x, m_parsnipText.size.y, m_parsnipText.texture, {0, 0, 0, 255});
 
             drawer->DrawRectangle(36, cameraSize.y - 4, 20, 20, {0, 0, 0, 255});
             drawer->DrawRectangle(37, cameraSize.y - 5, 18, 18, uiBackground);
-            m_world.IterateComps<Player>([&](Player& p)
+            if (frame.held)
             {
-                if (p.heldObject)
-                {
-                    drawer->DrawSprite(38, cameraSize.y - 6, 16, 16, m_world.GetComponent<SpriteRenderer>(p.heldObject.value()).sprite);
-                }
-            });
+                drawer->DrawSprite(38, cameraSize.y - 6, 16, 16, frame.held);
+            }
 
             drawer->DrawRectangle(4, cameraSize.y - 30, 15, 11, uiBackground);
-            auto timerColor = m_dayTimeLeft > 10 ? tako::Color(0, 0, 0, 255) : tako::Color(255, 0, 0, 255);
+            auto timerColor = frame.clock > 10 ? tako::Color(0, 0, 0, 255) : tako::Color(255, 0, 0, 255);
             drawer->DrawImage(6, cameraSize.y - 32, m_dayTimeLeftText.size.x, m_dayTimeLeftText.size.y, m_dayTimeLeftText.texture, timerColor);
         }
-        if (m_screen == SCREEN::EndScreen)
+        if (frame.screen == SCREEN::EndScreen)
         {
             drawer->SetCameraPosition({0, 0});
             auto renPos = tako::Vector2(m_textEndScreen.size.x * -0.5f, m_textEndScreen.size.y * 0.5f);
@@ -806,20 +2367,23 @@ public:
         }
     }
 
-    void DrawPressAny(tako::PixelArtDrawer* drawer)
+    void DrawPressAny(Gfx::Drawer* drawer)
     {
         drawer->Clear();
         drawer->SetCameraPosition({0, 0});
         drawer->DrawImage(-m_textPressAny.size.x/2, m_textPressAny.size.y/2, m_textPressAny.size.x, m_textPressAny.size.y, m_textPressAny.texture);
     }
 
-    void DrawTitle(tako::PixelArtDrawer* drawer)
+    void DrawTitle(Gfx::Drawer* drawer, const RenderFrame& frame)
     {
         constexpr auto uiBackground = tako::Color(238, 195, 154, 255);
         auto cameraSize = drawer->GetCameraViewSize();
         drawer->Clear();
-        drawer->SetCameraPosition(FitMapBound(m_level.MapBounds(), {170, 180}, cameraSize));
-        m_level.Draw(drawer);
+        drawer->SetCameraPosition(frame.camera);
+        for (auto& tile : frame.tiles)
+        {
+            drawer->DrawSprite(tile.x, tile.y, 16, 16, tile.sprite, frame.light);
+        }
         drawer->SetCameraPosition({0, 0});
         constexpr auto titleScale = 3;
         auto renPos = tako::Vector2(m_textTitle.size.x * titleScale * -0.5f, m_textTitle.size.y * titleScale * 0.5f + 40);
@@ -841,28 +2405,66 @@ private:
     Text m_currentDayText;
     Text m_dayTimeLeftText;
     Text m_parsnipText;
+    // What the texts show, only touched by Draw
+    int m_shownDay = 1;
+    int m_shownParsnips = 0;
+    int m_shownClock = 60;
+    int m_shownEnd = -1;
+    TripleBuffer<RenderFrame> m_frames;
+    tako::Vector2 m_viewSize;
+    std::atomic<uint32_t> m_sounds = 0;
+    Mixer m_mixer;
+    VoiceHandle m_tickVoice;
+    std::thread m_updateThread;
+    std::thread::id m_previousMainThread;
+    std::unique_ptr<ReplicaServer> m_server;
+    std::unique_ptr<ReplicaClient> m_client;
+    // One bit per slot with a player, the host's own is always there
+    uint8_t m_players = 1;
+    std::array<ActionState, MAX_PLAYERS> m_remoteActions = {};
+    uint32_t m_netSounds = 0;
+    std::mutex m_stepMutex;
+    std::condition_variable m_stepWake;
+    std::condition_variable m_stepDone;
+    bool m_stepQueued = false;
+    bool m_stepQuit = false;
+    ActionState m_stepActions;
+    float m_stepDt = 0;
     tako::Vector2 m_playerSpawn = {0, 0};
-    tako::Font* m_font;
+    std::shared_ptr<GameAssets> m_assets;
     tako::World m_world;
     Level m_level;
-    tako::Texture* m_parsnipUI;
-    tako::Sprite* m_waterCan;
-    tako::Sprite* m_seedBag;
-    tako::Sprite* m_parsnip;
-    std::array<tako::Sprite*, 12> m_playerSprites;
-    tako::PixelArtDrawer* m_drawer;
-    tako::AudioClip* m_clipDay;
-    tako::AudioClip* m_clipDrop;
-    tako::AudioClip* m_clipError;
-    tako::AudioClip* m_clipHarvest;
-    tako::AudioClip* m_clipLoop;
-    tako::AudioClip* m_clipMusic;
-    tako::AudioClip* m_clipPickup;
-    tako::AudioClip* m_clipSend;
-    tako::AudioClip* m_clipSow;
-    tako::AudioClip* m_clipSplash;
-    tako::AudioClip* m_clipTick;
-    tako::AudioClip* m_clipWater;
+    SpawnCallbacks m_spawnCallbacks;
+    Interactions m_interactions;
+    EventQueue m_events;
+    Particles m_particles;
+    Telemetry m_telemetry;
+    InputMap m_inputMap;
+    uint32_t m_frame = 0;
+    CommandBuffer m_commands;
+    ItemPool m_items;
+    float m_reloadTimer = RELOAD_INTERVAL;
+    bool m_clipsPending = false;
+    bool m_musicWanted = false;
+    bool m_drewFrame = false;
+    std::vector<tako::Entity> m_buildings;
+    RectBatch m_buildingRects;
+    std::vector<TileCoord> m_wellTiles;
+    std::vector<TileCoord> m_boxTiles;
+    FlowField m_wellField;
+    FlowField m_boxField;
+    FlowField m_dryField;
+    std::map<TileCoord, int> m_dryTargets;
+    // Rollouts per decision, the bot is off at 0
+    int m_botRollouts = 0;
+    Farmhand m_botHand = {};
+    const FlowField* m_botField = nullptr;
+    FlowField m_botPath;
+    size_t m_botDropSide = 0;
+    float m_botWait = 0;
+    float m_botDayTime = 0;
+    tako::Vector2 m_botLast;
+    uint64_t m_botSeed = 1;
 
     Text m_textPressAny;
     Text m_textTitle;
@@ -870,30 +2472,118 @@ private:
     Text m_textCredits;
     Text m_textEndScreen;
 
+    // Games without a drawer keep their texts empty
+    Text MakeText(std::string_view text)
+    {
+        return m_assets->Presentable() ? CreateText(m_assets->drawer, m_assets->font.get(), text) : Text{};
+    }
+
+    void UpdateText(Text& tex, std::string_view text)
+    {
+        if (m_assets->Presentable())
+        {
+            RerenderText(tex, m_assets->drawer, m_assets->font.get(), text);
+        }
+    }
+
+    // Updates only see the drawer through this, it may be on another thread
+    void ViewChanged()
+    {
+        if (m_assets->Presentable())
+        {
+            m_viewSize = m_assets->drawer->GetCameraViewSize();
+        }
+    }
+
+    void RunUpdates()
+    {
+        std::unique_lock<std::mutex> lock(m_stepMutex);
+        while (true)
+        {
+            m_stepWake.wait(lock, [&] { return m_stepQueued || m_stepQuit; });
+            if (m_stepQuit)
+            {
+                return;
+            }
+            lock.unlock();
+            Step(m_stepActions, m_stepDt);
+            lock.lock();
+            m_stepQueued = false;
+            m_stepDone.notify_all();
+        }
+    }
+
+    void JoinUpdates()
+    {
+        if (!m_updateThread.joinable())
+        {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_stepMutex);
+            m_stepQuit = true;
+        }
+        m_stepWake.notify_one();
+        m_updateThread.join();
+        m_stepQuit = false;
+        m_stepQueued = false;
+    }
+
+    void Sync()
+    {
+        m_commands.Apply(m_world);
+    }
+
+    void Emit(EventType type, bool audible = true, int value = 0)
+    {
+        m_events.Push({type, audible, value});
+        m_telemetry.Record(type, audible, value, m_currentDay, DAY_LENGTH - m_dayTimeLeft, m_frame);
+    }
+
+    bool IsAudible(const Player& player)
+    {
+        return true;
+    }
+
+    // Farmhands work silently, a staffed farm would drown out the player
+    bool IsAudible(const Farmhand& hand)
+    {
+        return false;
+    }
+
+    // From the middle of the tile, games nobody watches skip them
+    void Burst(const ParticleBurst& burst, int tileX, int tileY)
+    {
+        if (m_assets->Presentable())
+        {
+            m_particles.Emit(burst, {tileX * 16 + 8.0f, tileY * 16 + 8.0f});
+        }
+    }
+
+    // Sounds without a clip yet are skipped
     void LoadClips()
     {
-        m_clipDay = new tako::AudioClip("/Day.wav");
-        m_clipDrop = new tako::AudioClip("/Drop.wav");
-        m_clipError = new tako::AudioClip("/Error.wav");
-        m_clipHarvest = new tako::AudioClip("/Harvest.wav");
-        m_clipLoop = new tako::AudioClip("/Loop.wav");
-        m_clipMusic = new tako::AudioClip("/music.mp3");
-        m_clipPickup = new tako::AudioClip("/Pickup.wav");
-        m_clipSend = new tako::AudioClip("/Send.wav");
-        m_clipSow = new tako::AudioClip("/Sow.wav");
-        m_clipSplash = new tako::AudioClip("/Splash.wav");
-        m_clipTick = new tako::AudioClip("/Tick.wav");
-        m_clipWater = new tako::AudioClip("/Water.wav");
+        if (!m_assets->Presentable() || (!m_clipsPending && !m_musicWanted))
+        {
+            return;
+        }
+        m_clipsPending = m_assets->LoadClips();
+        auto music = m_assets->Clip(m_assets->clipMusic);
+        if (m_musicWanted && music)
+        {
+            tako::Audio::Play(*music, true);
+            m_musicWanted = false;
+        }
     }
 
-    void RenderEndText()
+    void RenderEndText(int parsnips)
     {
         std::stringstream str;
         str << "You harvested and sold\n"
-            << m_parsnipCount << " parsnips!\n"
+            << parsnips << " parsnips!\n"
             << "Thanks for playing my LD 47 game!\n"
             << "Enter/Start to play again";
-        RerenderText(m_textEndScreen, m_drawer, m_font, str.str());
+        UpdateText(m_textEndScreen, str.str());
     }
 
     float easeInSine(float x)
@@ -0,0 +1,221 @@
+#pragma once
+#include "Tako.hpp"
+#include "Events.hpp"
+#include "Graphics.hpp"
+#include "Font.hpp"
+#include "Level.hpp"
+#include "LazyAssets.hpp"
+#include "Mixer.hpp"
+#include "ResourceManager.hpp"
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <optional>
+#include <vector>
+
+// Everything a game draws and plays, loaded once and shared by every Game in the process.
+// Games only read it, apart from clips that arrive late and are filled in by the game drawing on the main thread.
+// Simulation assets have no drawer, sprites or clips at all, games using them never draw or make a sound.
+struct GameAssets
+{
+    Gfx::Drawer* drawer = nullptr;
+    // Shared with other asset sets on the same drawer, files they have in common are loaded once
+    std::shared_ptr<ResourceManager> resources;
+    std::unique_ptr<tako::Font> font;
+    TileSprites tileSprites = {};
+    Gfx::Texture* parsnipUI = nullptr;
+    Gfx::Sprite* waterCan = nullptr;
+    Gfx::Sprite* seedBag = nullptr;
+    Gfx::Sprite* parsnip = nullptr;
+    std::array<Gfx::Sprite*, 12> playerSprites = {};
+    ClipHandle clipDay;
+    ClipHandle clipDrop;
+    ClipHandle clipError;
+    ClipHandle clipHarvest;
+    ClipHandle clipLoop;
+    ClipHandle clipMusic;
+    ClipHandle clipPickup;
+    ClipHandle clipSend;
+    ClipHandle clipSow;
+    ClipHandle clipSplash;
+    ClipHandle clipTick;
+    ClipHandle clipWater;
+    // Each event's clip decoded again for the mixer, which needs the samples tako keeps to itself
+    std::array<std::optional<Sound>, (size_t) EventType::Count> sounds;
+    LazyAssets lazyAssets;
+
+    GameAssets() = default;
+    GameAssets(const GameAssets&) = delete;
+    GameAssets& operator=(const GameAssets&) = delete;
+
+    // Whatever only these assets used stays cached until the budget needs the room
+    ~GameAssets()
+    {
+        if (!resources)
+        {
+            return;
+        }
+        for (auto texture : m_textures)
+        {
+            resources->Release(texture);
+        }
+        for (auto clip : {clipDay, clipDrop, clipError, clipHarvest, clipLoop, clipMusic, clipPickup, clipSend, clipSow, clipSplash, clipTick, clipWater})
+        {
+            resources->Release(clip);
+        }
+    }
+
+    static std::shared_ptr<GameAssets> Load(Gfx::Drawer* drawer)
+    {
+        return Load(std::make_shared<ResourceManager>(drawer));
+    }
+
+    static std::shared_ptr<GameAssets> Load(std::shared_ptr<ResourceManager> resources)
+    {
+        auto assets = std::make_shared<GameAssets>();
+        auto drawer = resources->Drawer();
+        assets->drawer = drawer;
+        assets->resources = std::move(resources);
+        drawer->SetTargetSize(240, 135);
+        drawer->AutoScale();
+
+        assets->font = std::make_unique<tako::Font>("/charmap-cellphone.png", 5, 7, 1, 1, 2, 2,
+                                                    " !\"#$%&'()*+,-./0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]\a_`abcdefghijklmnopqrstuvwxyz{|}~");
+        auto tileset = assets->Texture("/Tileset.png");
+        assets->tileSprites = Level::CutTileSprites(drawer, assets->resources->Get(tileset), assets->resources->Size(tileset));
+        assets->waterCan = drawer->CreateSprite(assets->resources->Get(assets->Texture("/Watercan.png")), 0, 0, 16, 16);
+        assets->seedBag = drawer->CreateSprite(assets->resources->Get(assets->Texture("/SeedBag.png")), 0, 0, 16, 16);
+        assets->parsnip = drawer->CreateSprite(assets->resources->Get(assets->Texture("/Parsnip.png")), 0, 0, 16, 16);
+        assets->parsnipUI = assets->resources->Get(assets->Texture("/ParsnipUI.png"));
+        auto playerBit = assets->resources->Get(assets->Texture("/Player.png"));
+        for (int i = 0; i < assets->playerSprites.size(); i++)
+        {
+            assets->playerSprites[i] = drawer->CreateSprite(playerBit, i * 16, 0, 16, 24);
+        }
+        assets->LoadClips();
+        return assets;
+    }
+
+    static std::shared_ptr<GameAssets> Simulation()
+    {
+        return std::make_shared<GameAssets>();
+    }
+
+    bool Presentable() const
+    {
+        return drawer != nullptr;
+    }
+
+    // Sprites by number for sending them over the network, 0 is none or one that isn't known
+    uint8_t SpriteId(Gfx::Sprite* sprite) const
+    {
+        auto sprites = NetSprites();
+        for (size_t i = 1; sprite && i < sprites.size(); i++)
+        {
+            if (sprites[i] == sprite)
+            {
+                return i;
+            }
+        }
+        return 0;
+    }
+
+    Gfx::Sprite* SpriteAt(uint8_t id) const
+    {
+        auto sprites = NetSprites();
+        return id < sprites.size() ? sprites[id] : nullptr;
+    }
+
+    // Nothing while the clip's file is on its way
+    tako::AudioClip* Clip(ClipHandle clip) const
+    {
+        return resources ? resources->Get(clip) : nullptr;
+    }
+
+    // Clips are decoded as their files arrive, returns whether some are still on their way
+    bool LoadClips()
+    {
+        bool pending = false;
+        std::vector<tako::U8> contents;
+        auto load = [&](ClipHandle& clip, const char* file, EventType event = EventType::Count)
+        {
+            if (clip)
+            {
+                return;
+            }
+            if (lazyAssets.Ready(file))
+            {
+                // Read once for tako's clip and the mixer's samples both
+                if (!ResourceManager::ReadFile(file, contents))
+                {
+                    LOG_ERR("Could not read {}", file);
+                }
+                clip = resources->LoadClip(file, contents);
+                if (event != EventType::Count)
+                {
+                    sounds[(size_t) event] = Sound::FromWav(contents.data(), contents.size());
+                }
+            }
+            else
+            {
+                pending = true;
+            }
+        };
+        // Music first, it's the first thing played
+        load(clipMusic, "/music.mp3");
+        load(clipDay, "/Day.wav", EventType::DayPassed);
+        load(clipDrop, "/Drop.wav", EventType::Drop);
+        load(clipError, "/Error.wav", EventType::Error);
+        load(clipHarvest, "/Harvest.wav", EventType::Harvest);
+        load(clipLoop, "/Loop.wav", EventType::DayRewound);
+        load(clipPickup, "/Pickup.wav", EventType::Pickup);
+        load(clipSend, "/Send.wav", EventType::Deliver);
+        load(clipSow, "/Sow.wav", EventType::Sow);
+        load(clipSplash, "/Splash.wav", EventType::Fill);
+        load(clipTick, "/Tick.wav", EventType::ClockChanged);
+        load(clipWater, "/Water.wav", EventType::Water);
+        return pending;
+    }
+
+    ClipHandle ClipFor(EventType event) const
+    {
+        switch (event)
+        {
+            case EventType::Pickup: return clipPickup;
+            case EventType::Drop: return clipDrop;
+            case EventType::Harvest: return clipHarvest;
+            case EventType::Deliver: return clipSend;
+            case EventType::Sow: return clipSow;
+            case EventType::Water: return clipWater;
+            case EventType::Fill: return clipSplash;
+            case EventType::Error: return clipError;
+            case EventType::DayPassed: return clipDay;
+            case EventType::DayRewound: return clipLoop;
+            case EventType::ClockChanged: return clipTick;
+            default: return {};
+        }
+    }
+
+    // Nothing when the event's clip isn't loaded or isn't a WAV the mixer reads
+    const Sound* SoundFor(EventType event) const
+    {
+        auto& sound = sounds[(size_t) event];
+        return sound ? &*sound : nullptr;
+    }
+private:
+    // Held for the sprites cut from them
+    std::vector<TextureHandle> m_textures;
+
+    TextureHandle Texture(const char* file)
+    {
+        return m_textures.emplace_back(resources->LoadTexture(file));
+    }
+
+    // New sprites go at the end, hosts and clients have to agree on the numbers
+    std::array<Gfx::Sprite*, 16> NetSprites() const
+    {
+        std::array<Gfx::Sprite*, 16> sprites = { nullptr, waterCan, seedBag, parsnip };
+        std::copy(playerSprites.begin(), playerSprites.end(), sprites.begin() + 4);
+        return sprites;
+    }
+};
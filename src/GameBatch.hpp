@@ -0,0 +1,58 @@
+#pragma once
+#include "Game.hpp"
+#include "GameAssets.hpp"
+#include "Parallel.hpp"
+#include <memory>
+#include <vector>
+
+// Many games on one set of assets, stepped together with every game on whichever worker picks it up.
+// Games never touch each other, so each plays out the same as it would on its own.
+class GameBatch
+{
+public:
+    explicit GameBatch(std::shared_ptr<GameAssets> assets) : m_assets(std::move(assets))
+    {
+    }
+
+    // Games keep their address, they hand out pointers to themselves to their callbacks.
+    // A new game skips the title screens and is playing right away
+    Game& Add()
+    {
+        auto& game = *m_games.emplace_back(std::make_unique<Game>());
+        game.Setup(m_assets);
+        game.StartGame();
+        return game;
+    }
+
+    size_t Size() const
+    {
+        return m_games.size();
+    }
+
+    Game& operator[](size_t index)
+    {
+        return *m_games[index];
+    }
+
+    // Runs frames updates of every game that isn't over with the same input, returns how many are still playing
+    int Step(const ActionState& actions, float dt, int frames = 1)
+    {
+        std::atomic<int> playing = 0;
+        Parallel::For(m_games.size(), 1, [&](int begin, int end)
+        {
+            for (int i = begin; i < end; i++)
+            {
+                auto& game = *m_games[i];
+                for (int frame = 0; frame < frames && !game.IsOver(); frame++)
+                {
+                    game.Update(actions, dt);
+                }
+                playing += !game.IsOver();
+            }
+        });
+        return playing;
+    }
+private:
+    std::shared_ptr<GameAssets> m_assets;
+    std::vector<std::unique_ptr<Game>> m_games;
+};
@@ -0,0 +1,33 @@
+#pragma once
+#include "Tako.hpp"
+#ifdef SOFTWARE_RENDERER
+#include "SoftwareDrawer.hpp"
+#endif
+
+// What the game draws with, builds with SOFTWARE_RENDERER render on the CPU without a window
+namespace Gfx
+{
+#ifdef SOFTWARE_RENDERER
+    using Drawer = SoftwareDrawer;
+    using Texture = SoftwareDrawer::Texture;
+    using Sprite = SoftwareDrawer::Sprite;
+#else
+    using Drawer = tako::PixelArtDrawer;
+    using Texture = tako::Texture;
+    using Sprite = tako::Sprite;
+#endif
+
+    // tako's drawer can't free a texture, there they stay until the process exits
+#ifdef SOFTWARE_RENDERER
+    constexpr bool CAN_DESTROY_TEXTURES = true;
+#else
+    constexpr bool CAN_DESTROY_TEXTURES = false;
+#endif
+
+    inline void DestroyTexture(Drawer* drawer, Texture* texture)
+    {
+#ifdef SOFTWARE_RENDERER
+        drawer->DestroyTexture(texture);
+#endif
+    }
+}
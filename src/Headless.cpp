@@ -0,0 +1,167 @@
+#include "Tako.hpp"
+#include "Game.hpp"
+#include "GameBatch.hpp"
+#include "Mixer.hpp"
+#include "Transport.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+// Plays without a window or GPU, rendering on the CPU and writing every nth frame to disk.
+// Usage: ld47-headless [frames] [every nth frame, 0 for none] [output prefix] [telemetry file]
+// With LD47_BOT=rollouts the planning bot plays, the run ends with the game and reports the result.
+// LD47_WAV=file writes what the mixer makes of the game's sounds and reports the time spent mixing.
+// LD47_GAMES=n plays n games at once without drawing anything, each bot with its own seed.
+// LD47_COOP=n hosts a farm for n players with n - 1 of them joining over loopback, LD47_DROP=k loses every kth packet.
+
+static int RunBatch(int games, int frames, const char* bot)
+{
+    GameBatch batch(GameAssets::Simulation());
+    for (int i = 0; i < games; i++)
+    {
+        auto& added = batch.Add();
+        if (bot)
+        {
+            added.EnableBot(std::max(1, std::atoi(bot)), i + 1);
+        }
+    }
+    ActionState idle;
+    auto start = std::chrono::steady_clock::now();
+    int frame = 0;
+    // A few frames per step keeps the workers busy between the waits
+    constexpr int FRAMES_PER_STEP = 60;
+    while (frame < frames && batch.Step(idle, 1 / 60.0f, std::min(FRAMES_PER_STEP, frames - frame)) > 0)
+    {
+        frame += FRAMES_PER_STEP;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    long parsnips = 0;
+    double played = 0;
+    for (size_t i = 0; i < batch.Size(); i++)
+    {
+        parsnips += batch[i].Parsnips();
+        played += batch[i].Frames();
+    }
+    std::printf("%d games, %.1f parsnips per game, %.0f game frames/s, %zu bytes per game plus its level and world\n",
+                games, parsnips / (double) games, played / seconds, sizeof(Game));
+    return 0;
+}
+
+// The clients walk in circles picking things up, their own views are drawn from what the host sends
+static int RunCoop(int players, int frames, const char* bot)
+{
+    SoftwareDrawer drawer;
+    auto assets = GameAssets::Load(&drawer);
+    auto drop = std::getenv("LD47_DROP");
+    auto network = std::make_shared<LoopbackNetwork>(drop ? std::atoi(drop) : 0);
+    auto host = std::make_unique<Game>();
+    host->Setup(assets);
+    host->Host(network->Endpoint(0));
+    if (bot)
+    {
+        host->EnableBot(std::max(1, std::atoi(bot)));
+    }
+    std::vector<std::unique_ptr<Game>> clients;
+    for (int i = 1; i < std::min(players, MAX_PLAYERS); i++)
+    {
+        auto& client = *clients.emplace_back(std::make_unique<Game>());
+        client.Setup(assets);
+        client.Join(network->Endpoint(i));
+    }
+    host->StartGame();
+    constexpr std::array<Action, 4> walks = {Action::MoveRight, Action::MoveDown, Action::MoveLeft, Action::MoveUp};
+    ActionState idle;
+    int frame = 0;
+    for (; frame < frames && !host->IsOver(); frame++)
+    {
+        host->Update(idle, 1 / 60.0f);
+        for (size_t i = 0; i < clients.size(); i++)
+        {
+            ActionState walk;
+            walk.held = ActionBit(walks[(frame / 120 + i) % walks.size()]);
+            walk.pressed = frame % 97 == 0 ? ActionBit(Action::Pickup) : 0;
+            clients[i]->Update(walk, 1 / 60.0f);
+            clients[i]->Draw(&drawer);
+        }
+        host->Draw(&drawer);
+    }
+    double perClient = clients.empty() ? 0 : host->BytesServed() / (double) clients.size() / std::max(1, frame);
+    std::printf("%d players for %d frames, %.1f bytes per client per frame, host has %d parsnips, clients see %d\n",
+                (int) clients.size() + 1, frame, perClient, host->Parsnips(), clients.empty() ? 0 : clients[0]->Parsnips());
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    int frames = argc > 1 ? std::atoi(argv[1]) : 600;
+    if (auto games = std::getenv("LD47_GAMES"))
+    {
+        return RunBatch(std::max(1, std::atoi(games)), frames, std::getenv("LD47_BOT"));
+    }
+    if (auto players = std::getenv("LD47_COOP"))
+    {
+        return RunCoop(std::max(1, std::atoi(players)), frames, std::getenv("LD47_BOT"));
+    }
+    int every = argc > 2 ? std::max(0, std::atoi(argv[2])) : 60;
+    std::string prefix = argc > 3 ? argv[3] : "frame";
+
+    SoftwareDrawer drawer;
+    // Released before the drawer, which frees the game's textures
+    auto game = std::make_unique<Game>();
+    game->Setup(&drawer);
+    if (argc > 4)
+    {
+        game->OpenTelemetry(argv[4]);
+    }
+    auto bot = std::getenv("LD47_BOT");
+    if (bot)
+    {
+        game->EnableBot(std::max(1, std::atoi(bot)));
+    }
+    WavWriter wav;
+    auto wavFile = std::getenv("LD47_WAV");
+    if (wavFile && !wav.Open(wavFile))
+    {
+        std::fprintf(stderr, "Can't write %s\n", wavFile);
+        return 1;
+    }
+    constexpr int AUDIO_FRAMES = MIX_RATE / 60;
+    std::vector<float> mixed(AUDIO_FRAMES * MIX_CHANNELS);
+    std::vector<int16_t> pcm(mixed.size());
+    double mixSeconds = 0;
+    int peakVoices = 0;
+
+    game->StartGame();
+    tako::Input input;
+    auto start = std::chrono::steady_clock::now();
+    int frame = 0;
+    for (; frame < frames && !(bot && game->IsOver()); frame++)
+    {
+        game->Update(&input, 1 / 60.0f);
+        game->Draw(&drawer);
+        if (every > 0 && frame % every == 0)
+        {
+            drawer.SaveFrame((prefix + std::to_string(frame) + ".ppm").c_str());
+        }
+        if (wavFile)
+        {
+            auto mixStart = std::chrono::steady_clock::now();
+            peakVoices = std::max(peakVoices, game->Audio().Active());
+            game->Audio().Render(mixed.data(), AUDIO_FRAMES);
+            Mixer::ToPcm16(mixed.data(), pcm.data(), pcm.size());
+            mixSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - mixStart).count();
+            wav.Write(pcm.data(), pcm.size());
+        }
+    }
+    if (wavFile)
+    {
+        std::printf("%.1f s of audio mixed in %.2f ms, at most %d voices\n", frame / 60.0, mixSeconds * 1000, peakVoices);
+    }
+    if (bot)
+    {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::printf("%d parsnips in %d frames, %.0f frames/s\n", game->Parsnips(), frame, frame / seconds);
+    }
+    return 0;
+}
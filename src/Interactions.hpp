@@ -0,0 +1,43 @@
+#pragma once
+#include "World.hpp"
+#include "Objects.hpp"
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <optional>
+
+// Everything a handler gets to work with, it may change what the actor holds
+struct Interaction
+{
+    std::optional<tako::Entity>& held;
+    bool audible;
+    std::optional<tako::Entity> target;
+    int tileX;
+    int tileY;
+};
+
+// Handlers by held item and target, one table lookup per interaction
+class Interactions
+{
+public:
+    using Handler = std::function<bool(Interaction&)>;
+
+    void Register(ItemType item, TargetType target, Handler handler)
+    {
+        m_handlers[Index(item, target)] = std::move(handler);
+    }
+
+    // False when nothing handles the pair or the handler had nothing to do
+    bool Run(ItemType item, TargetType target, Interaction& interaction) const
+    {
+        auto& handler = m_handlers[Index(item, target)];
+        return handler && handler(interaction);
+    }
+private:
+    std::array<Handler, (size_t) ItemType::Count * (size_t) TargetType::Count> m_handlers;
+
+    static size_t Index(ItemType item, TargetType target)
+    {
+        return (size_t) item * (size_t) TargetType::Count + (size_t) target;
+    }
+};
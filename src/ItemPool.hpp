@@ -0,0 +1,109 @@
+#pragma once
+#include "World.hpp"
+#include "Objects.hpp"
+#include "Position.hpp"
+#include "Physics.hpp"
+#include "Renderer.hpp"
+#include <array>
+#include <cstddef>
+#include <vector>
+
+// Item entities are created once and then only change state, picking up, dropping, harvesting
+// and delivering never move an entity between archetypes
+class ItemPool
+{
+public:
+    template<class T>
+    void Reserve(tako::World& world, int count)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            m_free[Index(ItemTypeOf(T()))].push_back(Create<T>(world));
+        }
+    }
+
+    // A stored item of the type, or a new one once the pool runs dry, it starts out held
+    template<class T>
+    tako::Entity Take(tako::World& world, Gfx::Sprite* sprite, T value)
+    {
+        auto& free = m_free[Index(ItemTypeOf(value))];
+        tako::Entity entity;
+        if (free.empty())
+        {
+            entity = Create<T>(world);
+        }
+        else
+        {
+            entity = free.back();
+            free.pop_back();
+        }
+        world.GetComponent<T>(entity) = value;
+        world.GetComponent<SpriteRenderer>(entity).sprite = sprite;
+        SetState(world, entity, ItemState::Held);
+        return entity;
+    }
+
+    void Place(tako::World& world, tako::Entity entity, int x, int y)
+    {
+        Position& pos = world.GetComponent<Position>(entity);
+        pos.x = x * 16 + 8;
+        pos.y = y * 16 + 8;
+        Pickup& pickup = world.GetComponent<Pickup>(entity);
+        pickup.x = x;
+        pickup.y = y;
+        SetState(world, entity, ItemState::Placed);
+    }
+
+    void Hold(tako::World& world, tako::Entity entity)
+    {
+        SetState(world, entity, ItemState::Held);
+    }
+
+    void Release(tako::World& world, tako::Entity entity)
+    {
+        auto& item = world.GetComponent<Item>(entity);
+        if (item.state == ItemState::Stored)
+        {
+            return;
+        }
+        SetState(world, entity, ItemState::Stored);
+        m_free[Index(item.type)].push_back(entity);
+    }
+
+    // The world was reset along with every item in it
+    void Clear()
+    {
+        for (auto& free : m_free)
+        {
+            free.clear();
+        }
+    }
+private:
+    std::array<std::vector<tako::Entity>, (size_t) ItemType::Count> m_free;
+
+    static size_t Index(ItemType type)
+    {
+        return (size_t) type;
+    }
+
+    template<class T>
+    static tako::Entity Create(tako::World& world)
+    {
+        auto entity = world.Create<Position, SpriteRenderer, RigidBody, Pickup, Item, T>();
+        world.GetComponent<SpriteRenderer>(entity).size = {16, 16};
+        RigidBody& rigid = world.GetComponent<RigidBody>(entity);
+        rigid.size = {14, 14};
+        rigid.entity = entity;
+        world.GetComponent<Pickup>(entity).entity = entity;
+        world.GetComponent<Item>(entity).type = ItemTypeOf(T());
+        SetState(world, entity, ItemState::Stored);
+        return entity;
+    }
+
+    static void SetState(tako::World& world, tako::Entity entity, ItemState state)
+    {
+        world.GetComponent<Item>(entity).state = state;
+        // Only items lying on the ground get in the way
+        world.GetComponent<RigidBody>(entity).enabled = state == ItemState::Placed;
+    }
+};
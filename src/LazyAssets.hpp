@@ -0,0 +1,78 @@
+#pragma once
+#include "Tako.hpp"
+#include <cstdio>
+#include <map>
+#include <string>
+#ifdef __EMSCRIPTEN__
+#include <emscripten.h>
+#endif
+
+// Files the first frame doesn't need. The web build leaves them out of the preloaded package
+// and fetches them from the assets folder next to the page into the virtual file system on first request,
+// everywhere else they are on disk from the start.
+class LazyAssets
+{
+public:
+    static constexpr const char* URL_PREFIX = "assets";
+
+    // Starts fetching file if it isn't on its way yet and returns whether it can be opened now
+    bool Ready(const char* file)
+    {
+#ifdef __EMSCRIPTEN__
+        auto& fetch = Fetches()[file];
+        if (fetch.state == State::Missing)
+        {
+            fetch.state = State::Fetching;
+            fetch.file = file;
+            emscripten_async_wget_data((std::string(URL_PREFIX) + file).c_str(), &fetch, OnLoad, OnError);
+        }
+        return fetch.state == State::Ready;
+#else
+        return true;
+#endif
+    }
+private:
+#ifdef __EMSCRIPTEN__
+    enum class State
+    {
+        Missing,
+        Fetching,
+        Ready,
+        Failed
+    };
+
+    struct Fetch
+    {
+        State state = State::Missing;
+        std::string file;
+    };
+
+    // Map nodes don't move, so callbacks can hold on to their fetch
+    static std::map<std::string, Fetch>& Fetches()
+    {
+        static std::map<std::string, Fetch> fetches;
+        return fetches;
+    }
+
+    static void OnLoad(void* arg, void* data, int size)
+    {
+        auto fetch = static_cast<Fetch*>(arg);
+        auto out = std::fopen(fetch->file.c_str(), "wb");
+        if (!out)
+        {
+            fetch->state = State::Failed;
+            return;
+        }
+        std::fwrite(data, 1, size, out);
+        std::fclose(out);
+        fetch->state = State::Ready;
+    }
+
+    static void OnError(void* arg)
+    {
+        auto fetch = static_cast<Fetch*>(arg);
+        LOG_ERR("Could not fetch {}", fetch->file);
+        fetch->state = State::Failed;
+    }
+#endif
+};
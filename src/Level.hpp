@@ -1,8 +1,21 @@
 #pragma once
 #include "Tako.hpp"
+#include "Graphics.hpp"
 #include "Rect.hpp"
+#include "Chunk.hpp"
+#include "FarmGenerator.hpp"
+#include "Parallel.hpp"
 #include <map>
+#include <algorithm>
 #include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 namespace
@@ -10,155 +23,362 @@ namespace
     constexpr auto tilesetTileCount = 20;
 }
 
-struct BuildingSize
-{
-    int startIndex;
-    int x;
-    int y;
-
-    BuildingSize(int s, int x, int y)
-    {
-        startIndex = s;
-        this->x = x;
-        this->y = y;
-    }
-};
-
-const std::map<char, BuildingSize> BUILDING_INFO =
-{{
-    {'W', {13, 2, 2}},
-    {'B', {17, 2, 2}}
-}};
-
-struct Tile
-{
-    int index = 0;
-    bool solid = false;
-};
+using TileSprites = std::array<Gfx::Sprite*, tilesetTileCount>;
+using SpawnCallbacks = std::map<char, std::function<void(const Spawn&)>>;
 
+// Tiles are kept in chunks. Levels from a file stay loaded as a whole, generated farms only keep
+// the chunks around the focus and regenerate the rest on demand. What changed in a chunk while it
+// was loaded is kept aside until it comes back, within SAVED_BYTES.
 class Level
 {
 public:
-    void Init(tako::PixelArtDrawer* drawer, tako::Resources* resources)
+    // Chunks this close to the focus chunk get loaded, chunks further away than KEEP_RADIUS get evicted
+    static constexpr int LOAD_RADIUS = 1;
+    static constexpr int KEEP_RADIUS = 2;
+    // Memory for the changes of evicted chunks. Past it the changes evicted longest ago are forgotten and
+    // their chunks come back the way the generator makes them
+    static constexpr size_t SAVED_BYTES = 8 * 1024 * 1024;
+
+    // Removes everything inside the area from the game and returns it as spawns to put back on load
+    using Evict = std::function<std::vector<Spawn>(TileArea)>;
+
+    // Cuts the tileset into the sprites every level draws with
+    static TileSprites CutTileSprites(Gfx::Drawer* drawer, Gfx::Texture* tileset, tako::Vector2 size)
     {
-        auto bitmap = tako::Bitmap::FromFile("/Tileset.png");
-        auto tileset = drawer->CreateTexture(bitmap);
-        int tilesPerTilesetRow = bitmap.Width() / 16;
+        TileSprites sprites;
+        int tilesPerTilesetRow = size.x / 16;
         for (int i = 0; i < tilesetTileCount; i++)
         {
             int y = i / tilesPerTilesetRow;
             int x = i - y * tilesPerTilesetRow;
-            m_tileSprites[i] = drawer->CreateSprite(tileset, x * 16, y * 16, 16, 16);
+            sprites[i] = drawer->CreateSprite(tileset, x * 16, y * 16, 16, 16);
         }
+        return sprites;
     }
 
-    void LoadLevel(const char* file, std::map<char, std::function<void(int,int)>>& callbackMap)
+    // The sprites are shared with every other level and have to outlive this one
+    void Init(const TileSprites* tileSprites)
     {
-        m_tiles.clear();
-        constexpr size_t bufferSize = 1024 * 1024;
-        std::array <tako::U8, bufferSize> buffer;
-        size_t bytesRead = 0;
-        if (!tako::FileSystem::ReadFile(file, buffer.data(), bufferSize, bytesRead))
+        m_tileSprites = tileSprites;
+    }
+
+    // A file starting with "#generate <width> <height> <seed>" describes a generated farm instead of its tiles
+    void LoadLevel(const char* file, SpawnCallbacks& callbackMap)
+    {
+        auto source = ReadSource(file);
+        if (!source)
         {
             LOG_ERR("Could not read level {}", file);
         }
+        m_template = Parse(std::string(source.value_or("")));
+        Restart(callbackMap);
+    }
+
+    // Puts the level back the way its file was last read without reading or parsing it again. The tiles are
+    // copied chunk by chunk and everything on them is spawned kind by kind
+    void Restart(SpawnCallbacks& callbackMap)
+    {
+        // The same file restarted again keeps its chunks' memory
+        bool sameChunks = !m_generator && !m_template.generated && m_width == m_template.width && m_height == m_template.height;
+        if (!sameChunks)
+        {
+            m_chunks.clear();
+        }
+        m_saved.clear();
+        m_savedOrder.clear();
+        m_savedBytes = 0;
+        m_generator.reset();
+        m_solidChanges.clear();
+        m_source = m_template.source;
+        m_cells = m_template.cells;
+        m_width = m_template.width;
+        m_height = m_template.height;
 
-        auto levelStr = reinterpret_cast<const char *>(buffer.data());
-        std::vector<char> tileChars;
-        tileChars.reserve(bytesRead);
+        if (m_template.generated)
         {
-            int maxX = 0;
-            int maxY = 0;
-            int x = 0;
-            int y = 0;
+            m_generator.emplace(m_width, m_height, m_template.seed);
+            auto [spawnX, spawnY] = m_generator->PlayerSpawn();
+            Stream({tako::Vector2(spawnX * 16 + 8, spawnY * 16 + 8)}, callbackMap, nullptr);
+            return;
+        }
 
-            for (int i = 0; i < bytesRead; i++) {
-                if (levelStr[i] != '\n' && levelStr[i] != '\0') {
-                    x++;
-                    tileChars.push_back(levelStr[i]);
-                } else {
-                    maxY++;
-                    maxX = std::max(maxX, x);
-                    x = 0;
-                }
+        for (auto& [key, chunk] : m_template.chunks)
+        {
+            auto& loaded = m_chunks[key];
+            if (loaded)
+            {
+                *loaded = chunk;
             }
+            else
+            {
+                loaded = std::make_unique<Chunk>(chunk);
+            }
+        }
 
-            m_width = maxX;
-            m_height = maxY;
+        auto& spawns = m_template.spawns;
+        for (size_t begin = 0, end; begin < spawns.size(); begin = end)
+        {
+            end = begin + 1;
+            while (end < spawns.size() && spawns[end].type == spawns[begin].type)
+            {
+                end++;
+            }
+            auto callback = callbackMap.find(spawns[begin].type);
+            if (callback == callbackMap.end())
+            {
+                continue;
+            }
+            for (size_t i = begin; i < end; i++)
+            {
+                callback->second(spawns[i]);
+            }
         }
+    }
 
-        for (int i = 0; i < tileChars.size(); i++)
+    enum class ReloadResult
+    {
+        Unchanged,
+        Patched,
+        NeedsLoad
+    };
+
+    // Applies an edited level file to the cells the edit touched, everything else keeps its play state.
+    // Generated farms and files of another size can't be patched and need a full LoadLevel.
+    // An edit is taken once two calls in a row read the same text, a file that can't be read or is empty
+    // counts as unchanged, so an editor saving or replacing the file doesn't load it half written.
+    ReloadResult Reload(const char* file, SpawnCallbacks& callbackMap, const Evict& evict)
+    {
+        auto source = ReadSource(file);
+        if (!source || source->empty() || *source == m_source)
         {
-            Tile tile;
-            switch (tileChars[i])
-            {
-                case 'D':
-                    tile.index = 1;
-                    break;
-                case 'S':
-                    tile.index = 11;
-                    break;
-                case 'C':
-                    tile.index = 3;
-                    break;
-                case 'G':
-                case 'b':
-                case 'w':
-                    tile.index = 11;
-                    break;
-                case 'W':
-                case 'B':
-                    tile.index = BUILDING_INFO.at(tileChars[i]).startIndex;
-                    tile.solid = true;
-                    break;
-                case '+':
+            m_pendingSource.clear();
+            return ReloadResult::Unchanged;
+        }
+        if (*source != m_pendingSource)
+        {
+            m_pendingSource = *source;
+            return ReloadResult::Unchanged;
+        }
+        auto parsed = Parse(std::move(m_pendingSource));
+        m_pendingSource.clear();
+        auto& cells = parsed.cells;
+        if (m_generator || parsed.generated || parsed.width != m_width || parsed.height != m_height || cells.size() != m_cells.size())
+        {
+            // Restarts from here on start from the edited file
+            m_template = std::move(parsed);
+            return ReloadResult::NeedsLoad;
+        }
+
+        // A touched building is replaced as a whole, in its old and its new shape
+        std::vector<bool> dirty(cells.size());
+        for (int i = 0; i < cells.size(); i++)
+        {
+            if (cells[i] == m_cells[i])
+            {
+                continue;
+            }
+            dirty[i] = true;
+            MarkBuilding(m_cells, i, dirty);
+            MarkBuilding(cells, i, dirty);
+        }
+        m_template = std::move(parsed);
+        m_source = m_template.source;
+        m_cells = m_template.cells;
+
+        // Cleared in row runs, then every tile is set before anything spawns on them
+        for (int i = 0; i < m_cells.size();)
+        {
+            if (!dirty[i])
+            {
+                i++;
+                continue;
+            }
+            int begin = i;
+            while (i < m_cells.size() && dirty[i] && i / m_width == begin / m_width)
+            {
+                i++;
+            }
+            int y = m_height - begin / m_width;
+            evict({begin % m_width, y, (i - 1) % m_width, y});
+        }
+        for (int i = 0; i < m_cells.size(); i++)
+        {
+            if (dirty[i])
+            {
+                CopyCellTile(i);
+            }
+        }
+        for (int i = 0; i < m_cells.size(); i++)
+        {
+            if (dirty[i])
+            {
+                RunCallback(i, callbackMap);
+            }
+        }
+        return ReloadResult::Patched;
+    }
+
+    // Loads the chunks around every focus and evicts the ones far from all of them, returns whether any chunk came or went
+    bool Stream(const std::vector<tako::Vector2>& foci, SpawnCallbacks& callbackMap, const Evict& evict)
+    {
+        if (!m_generator)
+        {
+            return false;
+        }
+        std::vector<std::pair<int, int>> focusChunks;
+        for (auto focus : foci)
+        {
+            focusChunks.emplace_back(((int) focus.x) / 16 / CHUNK_SIZE, ((int) focus.y) / 16 / CHUNK_SIZE);
+        }
+        bool changed = false;
+
+        // Evicted in key order so the same walk always gives the same world
+        std::vector<uint64_t> far;
+        for (auto& [key, chunk] : m_chunks)
+        {
+            bool kept = std::any_of(focusChunks.begin(), focusChunks.end(), [&](std::pair<int, int> focus)
+            {
+                return std::abs(chunk->x - focus.first) <= KEEP_RADIUS && std::abs(chunk->y - focus.second) <= KEEP_RADIUS;
+            });
+            if (!kept)
+            {
+                far.push_back(key);
+            }
+        }
+        std::sort(far.begin(), far.end());
+        for (auto key : far)
+        {
+            auto chunk = std::move(m_chunks[key]);
+            m_chunks.erase(key);
+            chunk->spawns = evict(ChunkArea(chunk->x, chunk->y));
+            std::sort(chunk->spawns.begin(), chunk->spawns.end());
+            Chunk generated;
+            m_generator->Generate(chunk->x, chunk->y, generated);
+            // Only chunks that differ from what the generator makes cost memory after leaving
+            if (!chunk->SameContent(generated))
+            {
+                Save(key, *chunk, generated);
+            }
+            changed = true;
+        }
+
+        std::vector<std::pair<int, int>> missing;
+        for (auto [focusX, focusY] : focusChunks)
+        {
+            for (int cy = focusY - LOAD_RADIUS; cy <= focusY + LOAD_RADIUS; cy++)
+            {
+                for (int cx = focusX - LOAD_RADIUS; cx <= focusX + LOAD_RADIUS; cx++)
                 {
-                    int bx = 0;
-                    int by = 0;
-                    while(i-bx > 0 && (tileChars[i-bx] == '+' || BUILDING_INFO.find(tileChars[i-bx]) != BUILDING_INFO.end()))
+                    if (cx < 0 || cy < 0 || cx * CHUNK_SIZE >= m_width || cy * CHUNK_SIZE > m_height || m_chunks.count(Key(cx, cy)))
                     {
-                        bx++;
+                        continue;
                     }
-                    while(i-by*m_width > 0 && (tileChars[i-by*m_width] == '+' || BUILDING_INFO.find(tileChars[i-by*m_width]) != BUILDING_INFO.end()))
+                    // Foci close together want the same chunks
+                    if (std::find(missing.begin(), missing.end(), std::make_pair(cx, cy)) == missing.end())
                     {
-                        by++;
+                        missing.emplace_back(cx, cy);
                     }
-                    bx--;
-                    by--;
-                    auto building = BUILDING_INFO.find(tileChars[i-bx-by*m_width]);
-                    tile.index = building->second.startIndex + bx + by * building->second.x;
-                    tile.solid = true;
-                    break;
                 }
             }
+        }
+        std::vector<std::unique_ptr<Chunk>> loaded(missing.size());
+        Parallel::For(missing.size(), 1, [&](int begin, int end)
+        {
+            for (int i = begin; i < end; i++)
+            {
+                loaded[i] = std::make_unique<Chunk>();
+                m_generator->Generate(missing[i].first, missing[i].second, *loaded[i]);
+            }
+        });
+        for (size_t i = 0; i < missing.size(); i++)
+        {
+            auto saved = m_saved.find(Key(missing[i].first, missing[i].second));
+            if (saved != m_saved.end())
+            {
+                Restore(*loaded[i], saved->second);
+                Forget(saved);
+            }
+        }
 
-            m_tiles.push_back(tile);
-            if (callbackMap.find(tileChars[i]) != callbackMap.end())
+        // Every new chunk is in place before anything spawns on them
+        std::vector<Spawn> spawns;
+        for (auto& chunk : loaded)
+        {
+            spawns.insert(spawns.end(), chunk->spawns.begin(), chunk->spawns.end());
+            chunk->spawns.clear();
+            m_chunks[Key(chunk->x, chunk->y)] = std::move(chunk);
+            changed = true;
+        }
+        for (auto& spawn : spawns)
+        {
+            auto callback = callbackMap.find(spawn.type);
+            if (callback != callbackMap.end())
             {
-                int y = m_height - i / m_width;
-                int x = i % m_width;
-                callbackMap[tileChars[i]](x, y);
+                callback->second(spawn);
             }
         }
+
+        return changed;
     }
 
-    void Draw(tako::PixelArtDrawer* drawer, tako::Color color = {255, 255, 255, 255})
+    struct TileDraw
     {
-        for (int y = m_height; y >= 0; y--)
+        float x;
+        float y;
+        Gfx::Sprite* sprite;
+    };
+
+    // The tiles in view in drawing order, appended to out. Only reads the level, so the draws can be
+    // submitted later from another thread while the level changes
+    void GatherTiles(Rect view, std::vector<TileDraw>& out)
+    {
+        auto [x0, y0, x1, y1] = VisibleArea(view);
+        int rows = std::max(0, y1 - y0 + 1);
+
+        // Rows are gathered in parallel and joined in order
+        m_drawRows.resize(rows);
+        Parallel::For(rows, 16, [&](int begin, int end)
         {
-            for (int x = 0; x < m_width; x++)
+            for (int row = begin; row < end; row++)
             {
-                int i = (m_height - y) * m_width + x;
-                int tile = m_tiles[i].index;
-                if (tile == 0)
+                int y = y1 - row;
+                auto& list = m_drawRows[row];
+                list.clear();
+                for (int x = x0; x <= x1; x++)
                 {
-                    continue;
-                }
+                    auto chunk = Find(x / CHUNK_SIZE, y / CHUNK_SIZE);
+                    if (!chunk)
+                    {
+                        x += CHUNK_SIZE - 1 - x % CHUNK_SIZE;
+                        continue;
+                    }
+                    int tile = chunk->At(x % CHUNK_SIZE, y % CHUNK_SIZE).index;
+                    if (tile == 0)
+                    {
+                        continue;
+                    }
 
-                drawer->DrawSprite(x * 16, y * 16 + 16, 16, 16, m_tileSprites[tile - 1], color);
+                    list.push_back({x * 16.0f, y * 16.0f + 16, (*m_tileSprites)[tile - 1]});
+                }
             }
+        });
+
+        for (auto& list : m_drawRows)
+        {
+            out.insert(out.end(), list.begin(), list.end());
         }
+    }
 
+    // Every tile drawn in view, clamped to the map
+    TileArea VisibleArea(Rect view)
+    {
+        return
+        {
+            std::max(0, (int) std::floor(view.Left() / 16)),
+            std::max(0, (int) std::floor(view.Bottom() / 16) - 1),
+            std::min(m_width - 1, (int) std::ceil(view.Right() / 16)),
+            std::min(m_height, (int) std::ceil(view.Top() / 16))
+        };
     }
 
     Rect MapBounds()
@@ -176,69 +396,441 @@ public:
 
     std::optional<Tile*> GetTile(int x, int y)
     {
-        if (x < 0 || x > m_width || y < 0 || y > m_height)
+        if (x < 0 || x >= m_width || y < 0 || y > m_height)
+        {
+            return {};
+        }
+        auto chunk = Find(x / CHUNK_SIZE, y / CHUNK_SIZE);
+        if (!chunk)
         {
             return {};
         }
-        return { &m_tiles[x + (m_height - y) * m_width] };
+        return { &chunk->At(x % CHUNK_SIZE, y % CHUNK_SIZE) };
     }
 
     void ResetWatered()
     {
-        for (auto& tile : m_tiles)
+        auto dry = [](Tile& tile)
         {
             if (tile.index >= 1 && tile.index <= 10)
             {
                 tile.index += tile.index % 2 - 1;
             }
+        };
+        for (auto& [key, chunk] : m_chunks)
+        {
+            std::for_each(chunk->tiles.begin(), chunk->tiles.end(), dry);
         }
+        for (auto& [key, saved] : m_saved)
+        {
+            for (auto& change : saved.tiles)
+            {
+                dry(change.tile);
+            }
+        }
+    }
+
+    void SetSolid(int x, int y, bool solid)
+    {
+        if (!GetTile(x, y))
+        {
+            return;
+        }
+        Find(x / CHUNK_SIZE, y / CHUNK_SIZE)->SetSolid(x % CHUNK_SIZE, y % CHUNK_SIZE, solid);
+        m_solidChanges.emplace_back(x, y);
+    }
+
+    // Tiles whose solidity changed since the last call
+    std::vector<std::pair<int, int>> TakeSolidChanges()
+    {
+        return std::move(m_solidChanges);
+    }
+
+    int Width()
+    {
+        return m_width;
+    }
+
+    int Height()
+    {
+        return m_height;
+    }
+
+    bool Generated()
+    {
+        return m_generator.has_value();
+    }
+
+    // Every loaded chunk, sorted
+    std::vector<std::pair<int, int>> ResidentChunks()
+    {
+        std::vector<std::pair<int, int>> chunks;
+        chunks.reserve(m_chunks.size());
+        for (auto& [key, chunk] : m_chunks)
+        {
+            chunks.emplace_back(chunk->x, chunk->y);
+        }
+        std::sort(chunks.begin(), chunks.end());
+        return chunks;
+    }
+
+    // Tiles outside the map or in chunks that aren't loaded are solid
+    bool IsSolid(int x, int y)
+    {
+        if (x < 0 || x >= m_width || y < 0 || y >= m_height)
+        {
+            return true;
+        }
+        auto chunk = Find(x / CHUNK_SIZE, y / CHUNK_SIZE);
+        return !chunk || (chunk->solid[y % CHUNK_SIZE] >> (x % CHUNK_SIZE) & 1);
     }
 
     std::optional<Rect> Overlap(Rect rect)
     {
-        /*
-            TL TM TR
-            ML MM MR
-            BL BM BR
-        */
-        int tileX = ((int) rect.x) / 16;
-        int tileY = ((int) rect.y) / 16;
+        // Every tile the rect touches, one masked word test per chunk row
+        int x0 = (int) std::floor(rect.Left() / 16);
+        int x1 = (int) std::ceil(rect.Right() / 16) - 1;
+        int y0 = (int) std::floor(rect.Bottom() / 16);
+        int y1 = (int) std::ceil(rect.Top() / 16) - 1;
+        if (x1 < x0 || y1 < y0)
+        {
+            return std::nullopt;
+        }
 
-        Rect r;
-        for (int y = -1; y <= 1; y++)
+        auto hit = [](int x, int y)
         {
-            for (int x = -1; x <= 1; x++)
+            return Rect(x * 16.0f + 8, y * 16.0f + 8, 16, 16);
+        };
+        for (int y = y0; y <= y1; y++)
+        {
+            if (y < 0 || y >= m_height || x0 < 0 || x1 >= m_width)
             {
-                int tX = tileX + x;
-                int tY = tileY + y;
-
-                if (tX < 0 || tX >= m_width || tY < 0 || tY >= m_height)
+                return hit(x0 < 0 || y < 0 || y >= m_height ? x0 : x1, y);
+            }
+            for (int cx = x0 / CHUNK_SIZE; cx <= x1 / CHUNK_SIZE; cx++)
+            {
+                int from = std::max(x0, cx * CHUNK_SIZE);
+                auto chunk = Find(cx, y / CHUNK_SIZE);
+                if (!chunk)
                 {
-                    r = { tX * 16.0f + 8, tY * 16.0f + 8, 16, 16};
-                    if (Rect::Overlap(r, rect))
-                    {
-                        return r;
-                    }
+                    return hit(from, y);
                 }
-                int i = (m_height - tY) * m_width + tX;
-                if (!m_tiles[i].solid)
+                int lo = from % CHUNK_SIZE;
+                int hi = std::min(x1, cx * CHUNK_SIZE + CHUNK_SIZE - 1) % CHUNK_SIZE;
+                uint64_t mask = (~uint64_t(0) >> (CHUNK_SIZE - 1 - hi)) & (~uint64_t(0) << lo);
+                uint64_t solid = chunk->solid[y % CHUNK_SIZE] & mask;
+                if (solid)
                 {
-                    continue;
+                    return hit(cx * CHUNK_SIZE + LowestBit(solid), y);
                 }
+            }
+        }
+        return std::nullopt;
+    }
+private:
 
-                r = { tX * 16.0f + 8, tY * 16.0f + 8, 16, 16};
-                if (Rect::Overlap(r, rect))
+    // Nothing when the file can't be read. The text stays valid until the next read, which reuses the buffer
+    std::optional<std::string_view> ReadSource(const char* file)
+    {
+        constexpr size_t bufferSize = 1024 * 1024;
+        m_readBuffer.resize(bufferSize);
+        size_t bytesRead = 0;
+        if (!tako::FileSystem::ReadFile(file, m_readBuffer.data(), bufferSize, bytesRead))
+        {
+            return {};
+        }
+        return std::string_view(reinterpret_cast<const char*>(m_readBuffer.data()), bytesRead);
+    }
+
+    // One char per tile in file order, the first row is the top of the map
+    static std::vector<char> ParseCells(const std::string& source, int& width, int& height)
+    {
+        std::vector<char> cells;
+        cells.reserve(source.size());
+        int maxX = 0;
+        int maxY = 0;
+        int x = 0;
+        for (int i = 0; i < source.size(); i++) {
+            if (source[i] != '\n' && source[i] != '\0') {
+                x++;
+                cells.push_back(source[i]);
+            } else {
+                maxY++;
+                maxX = std::max(maxX, x);
+                x = 0;
+            }
+        }
+
+        width = maxX;
+        height = maxY;
+        return cells;
+    }
+
+    // The cell holding the building char for a '+', building chars are their own anchor
+    static int Anchor(const std::vector<char>& cells, int width, int i)
+    {
+        int bx = 0;
+        int by = 0;
+        while(i-bx > 0 && (cells[i-bx] == '+' || BUILDING_INFO.find(cells[i-bx]) != BUILDING_INFO.end()))
+        {
+            bx++;
+        }
+        while(i-by*width > 0 && (cells[i-by*width] == '+' || BUILDING_INFO.find(cells[i-by*width]) != BUILDING_INFO.end()))
+        {
+            by++;
+        }
+        bx--;
+        by--;
+        return i-bx-by*width;
+    }
+
+    void MarkBuilding(const std::vector<char>& cells, int i, std::vector<bool>& dirty)
+    {
+        if (cells[i] != '+' && BUILDING_INFO.find(cells[i]) == BUILDING_INFO.end())
+        {
+            return;
+        }
+        int anchor = cells[i] == '+' ? Anchor(cells, m_width, i) : i;
+        auto building = BUILDING_INFO.find(cells[anchor]);
+        if (building == BUILDING_INFO.end())
+        {
+            return;
+        }
+        for (int by = 0; by < building->second.y; by++)
+        {
+            for (int bx = 0; bx < building->second.x; bx++)
+            {
+                int cell = anchor + bx + by * m_width;
+                if (cell < dirty.size())
                 {
-                    return r;
+                    dirty[cell] = true;
                 }
             }
         }
+    }
 
-        return std::nullopt;
+    // The tile a cell of the file stands for
+    static Tile CellTile(const std::vector<char>& cells, int width, int i)
+    {
+        Tile tile;
+        switch (cells[i])
+        {
+            case 'D':
+                tile.index = 1;
+                break;
+            case 'S':
+                tile.index = 11;
+                break;
+            case 'C':
+                tile.index = 3;
+                break;
+            case 'G':
+            case 'b':
+            case 'w':
+            case 'F':
+                tile.index = 11;
+                break;
+            case 'W':
+            case 'B':
+                tile.index = BUILDING_INFO.at(cells[i]).startIndex;
+                tile.solid = true;
+                break;
+            case '+':
+            {
+                int anchor = Anchor(cells, width, i);
+                int bx = (i - anchor) % width;
+                int by = (i - anchor) / width;
+                auto building = BUILDING_INFO.find(cells[anchor]);
+                tile.index = building->second.startIndex + bx + by * building->second.x;
+                tile.solid = true;
+                break;
+            }
+        }
+        return tile;
     }
-private:
-    std::array<tako::Sprite*, tilesetTileCount> m_tileSprites;
-    std::vector<Tile> m_tiles;
-    int m_width;
-    int m_height;
-};
\ No newline at end of file
+
+    // Cells putting something into the world besides their tile
+    static bool Spawns(char cell)
+    {
+        return std::string_view("SCWBbwF").find(cell) != std::string_view::npos;
+    }
+
+    // The level as its file describes it, before anything was played on it
+    struct Template
+    {
+        std::string source;
+        bool generated = false;
+        unsigned long long seed = 0;
+        int width = 0;
+        int height = 0;
+        std::vector<char> cells;
+        std::unordered_map<uint64_t, Chunk> chunks;
+        // Grouped by kind, in file order within a kind
+        std::vector<Spawn> spawns;
+    };
+
+    static Template Parse(std::string source)
+    {
+        Template level;
+        level.source = std::move(source);
+        if (std::sscanf(level.source.c_str(), "#generate %d %d %llu", &level.width, &level.height, &level.seed) == 3)
+        {
+            level.generated = true;
+            return level;
+        }
+
+        level.cells = ParseCells(level.source, level.width, level.height);
+        for (int i = 0; i < level.cells.size(); i++)
+        {
+            int y = level.height - i / level.width;
+            int x = i % level.width;
+            auto [chunk, added] = level.chunks.try_emplace(Key(x / CHUNK_SIZE, y / CHUNK_SIZE));
+            if (added)
+            {
+                chunk->second.x = x / CHUNK_SIZE;
+                chunk->second.y = y / CHUNK_SIZE;
+            }
+            auto tile = CellTile(level.cells, level.width, i);
+            chunk->second.At(x % CHUNK_SIZE, y % CHUNK_SIZE).index = tile.index;
+            chunk->second.SetSolid(x % CHUNK_SIZE, y % CHUNK_SIZE, tile.solid);
+            if (Spawns(level.cells[i]))
+            {
+                level.spawns.push_back({level.cells[i], x, y, {}});
+            }
+        }
+        std::stable_sort(level.spawns.begin(), level.spawns.end(), [](const Spawn& a, const Spawn& b) { return a.type < b.type; });
+        return level;
+    }
+
+    void CopyCellTile(int i)
+    {
+        int y = m_height - i / m_width;
+        int x = i % m_width;
+        auto& tile = m_template.chunks.at(Key(x / CHUNK_SIZE, y / CHUNK_SIZE)).At(x % CHUNK_SIZE, y % CHUNK_SIZE);
+        auto& chunk = m_chunks[Key(x / CHUNK_SIZE, y / CHUNK_SIZE)];
+        if (!chunk)
+        {
+            chunk = std::make_unique<Chunk>();
+            chunk->x = x / CHUNK_SIZE;
+            chunk->y = y / CHUNK_SIZE;
+        }
+        chunk->At(x % CHUNK_SIZE, y % CHUNK_SIZE).index = tile.index;
+        chunk->SetSolid(x % CHUNK_SIZE, y % CHUNK_SIZE, tile.solid);
+    }
+
+    void RunCallback(int i, SpawnCallbacks& callbackMap)
+    {
+        if (callbackMap.find(m_cells[i]) != callbackMap.end())
+        {
+            callbackMap[m_cells[i]]({m_cells[i], i % m_width, m_height - i / m_width, {}});
+        }
+    }
+
+    const TileSprites* m_tileSprites = nullptr;
+    std::vector<std::vector<TileDraw>> m_drawRows;
+    std::unordered_map<uint64_t, std::unique_ptr<Chunk>> m_chunks;
+    // An evicted chunk as the tiles that differ from the generator's and everything that was on it
+    struct SavedChunk
+    {
+        struct TileChange
+        {
+            uint8_t x;
+            uint8_t y;
+            Tile tile;
+        };
+
+        std::vector<TileChange> tiles;
+        std::vector<Spawn> spawns;
+        // When it was evicted, the oldest is forgotten first
+        uint64_t order = 0;
+        // Counted when saved, restoring takes the spawns
+        size_t bytes = 0;
+
+        size_t Bytes() const
+        {
+            size_t bytes = sizeof(SavedChunk) + tiles.capacity() * sizeof(TileChange) + spawns.capacity() * sizeof(Spawn);
+            for (auto& spawn : spawns)
+            {
+                bytes += spawn.state.capacity() * sizeof(int);
+            }
+            return bytes;
+        }
+    };
+
+    std::unordered_map<uint64_t, SavedChunk> m_saved;
+    // Keys of the saved chunks by when they were evicted
+    std::map<uint64_t, uint64_t> m_savedOrder;
+    uint64_t m_evictions = 0;
+    size_t m_savedBytes = 0;
+    std::optional<FarmGenerator> m_generator;
+    std::vector<std::pair<int, int>> m_solidChanges;
+    // What the level file said when it was last read, reloads are diffed against it
+    std::string m_source;
+    // An edit read once, applied when the next read agrees
+    std::string m_pendingSource;
+    std::vector<tako::U8> m_readBuffer;
+    std::vector<char> m_cells;
+    Template m_template;
+    int m_width = 0;
+    int m_height = 0;
+
+    static uint64_t Key(int chunkX, int chunkY)
+    {
+        return uint64_t(uint32_t(chunkY)) << 32 | uint32_t(chunkX);
+    }
+
+    Chunk* Find(int chunkX, int chunkY)
+    {
+        auto it = m_chunks.find(Key(chunkX, chunkY));
+        return it == m_chunks.end() ? nullptr : it->second.get();
+    }
+
+    TileArea ChunkArea(int chunkX, int chunkY)
+    {
+        return {chunkX * CHUNK_SIZE, chunkY * CHUNK_SIZE, chunkX * CHUNK_SIZE + CHUNK_SIZE - 1, chunkY * CHUNK_SIZE + CHUNK_SIZE - 1};
+    }
+
+    void Save(uint64_t key, Chunk& chunk, Chunk& generated)
+    {
+        SavedChunk saved;
+        for (int y = 0; y < CHUNK_SIZE; y++)
+        {
+            for (int x = 0; x < CHUNK_SIZE; x++)
+            {
+                if (!(chunk.At(x, y) == generated.At(x, y)))
+                {
+                    saved.tiles.push_back({uint8_t(x), uint8_t(y), chunk.At(x, y)});
+                }
+            }
+        }
+        saved.tiles.shrink_to_fit();
+        saved.spawns = std::move(chunk.spawns);
+        saved.order = m_evictions++;
+        saved.bytes = saved.Bytes();
+        m_savedBytes += saved.bytes;
+        m_savedOrder[saved.order] = key;
+        m_saved[key] = std::move(saved);
+        while (m_savedBytes > SAVED_BYTES)
+        {
+            Forget(m_saved.find(m_savedOrder.begin()->second));
+        }
+    }
+
+    // Puts the changes back on the chunk the generator made
+    void Restore(Chunk& chunk, SavedChunk& saved)
+    {
+        for (auto& change : saved.tiles)
+        {
+            chunk.At(change.x, change.y).index = change.tile.index;
+            chunk.SetSolid(change.x, change.y, change.tile.solid);
+        }
+        chunk.spawns = std::move(saved.spawns);
+    }
+
+    void Forget(std::unordered_map<uint64_t, SavedChunk>::iterator saved)
+    {
+        m_savedBytes -= saved->second.bytes;
+        m_savedOrder.erase(saved->second.order);
+        m_saved.erase(saved);
+    }
+};
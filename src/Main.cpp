@@ -1,16 +1,37 @@
 #include "Tako.hpp"
 #include "Game.hpp"
+#include <cstdlib>
 
 static Game game;
 
 void tako::Setup(tako::PixelArtDrawer* drawer, Resources* resources)
 {
-    game.Setup(drawer, resources);
+    game.Setup(drawer);
+    // LD47_TELEMETRY=file records gameplay events, ld47-telemetry prints them
+    if (auto file = std::getenv("LD47_TELEMETRY"))
+    {
+        game.OpenTelemetry(file);
+    }
+    // LD47_BOT=rollouts hands the controls to the planning bot
+    if (auto bot = std::getenv("LD47_BOT"))
+    {
+        game.EnableBot(std::max(1, std::atoi(bot)));
+    }
+    // tako plays the sounds, the mixer only decides which may start
+    game.Audio().PlayElsewhere(true);
+    // The next update runs while this one's frame is drawn, the web build has no threads and keeps them in turn
+    game.EnableUpdateThread();
+    // game was constructed before the scheduler and would be destroyed after it. Handlers registered once the
+    // scheduler exists run before it is destroyed, so the update thread stops while the scheduler is still there
+    Parallel::GetScheduler();
+    std::atexit([] { game.StopUpdateThread(); });
 }
 
 void tako::Update(tako::Input* input, float dt)
 {
     game.Update(input, dt);
+    // The mixer follows tako's playback to know which voices are still busy
+    game.Audio().Advance(dt);
 }
 
 void tako::Draw(tako::PixelArtDrawer* drawer)
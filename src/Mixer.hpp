@@ -0,0 +1,482 @@
+#pragma once
+#include "Tako.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <vector>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MIXER_SSE
+#endif
+
+constexpr int MIX_RATE = 44100;
+constexpr int MIX_CHANNELS = 2;
+
+// Decoded samples as stereo frames at MIX_RATE, whatever the file had
+struct Sound
+{
+    std::vector<float> samples;
+
+    size_t Frames() const
+    {
+        return samples.size() / MIX_CHANNELS;
+    }
+
+    // PCM with 8 or 16 bit or float samples, mono or stereo, at any rate. Nothing for anything else
+    static std::optional<Sound> FromWav(const uint8_t* data, size_t size)
+    {
+        auto u16 = [&](size_t at) { return uint16_t(data[at] | data[at + 1] << 8); };
+        auto u32 = [&](size_t at) { return uint32_t(u16(at) | u16(at + 2) << 16); };
+        if (size < 12 || std::memcmp(data, "RIFF", 4) || std::memcmp(data + 8, "WAVE", 4))
+        {
+            return {};
+        }
+        int format = 0;
+        int channels = 0;
+        int rate = 0;
+        int bits = 0;
+        const uint8_t* pcm = nullptr;
+        size_t pcmSize = 0;
+        for (size_t at = 12; at + 8 <= size;)
+        {
+            size_t chunkSize = std::min<size_t>(u32(at + 4), size - at - 8);
+            if (!std::memcmp(data + at, "fmt ", 4) && chunkSize >= 16)
+            {
+                format = u16(at + 8);
+                channels = u16(at + 10);
+                rate = u32(at + 12);
+                bits = u16(at + 22);
+            }
+            else if (!std::memcmp(data + at, "data", 4))
+            {
+                pcm = data + at + 8;
+                pcmSize = chunkSize;
+            }
+            at += 8 + chunkSize + (chunkSize & 1);
+        }
+        bool supported = (format == 1 && (bits == 8 || bits == 16)) || (format == 3 && bits == 32);
+        if (!pcm || !supported || channels < 1 || channels > 2 || rate <= 0)
+        {
+            return {};
+        }
+
+        size_t bytesPerSample = bits / 8;
+        size_t frames = pcmSize / (bytesPerSample * channels);
+        auto sample = [&](size_t frame, int channel)
+        {
+            auto at = pcm + (frame * channels + std::min(channel, channels - 1)) * bytesPerSample;
+            switch (bits)
+            {
+                case 8: return (at[0] - 128) / 128.0f;
+                case 16: return int16_t(at[0] | at[1] << 8) / 32768.0f;
+                default:
+                {
+                    float value;
+                    std::memcpy(&value, at, sizeof(value));
+                    return value;
+                }
+            }
+        };
+        // Other rates are resampled linearly, sound effects don't need better
+        Sound sound;
+        double step = rate / (double) MIX_RATE;
+        size_t outFrames = frames == 0 ? 0 : size_t((frames - 1) / step) + 1;
+        sound.samples.resize(outFrames * MIX_CHANNELS);
+        for (size_t i = 0; i < outFrames; i++)
+        {
+            double at = i * step;
+            size_t frame = (size_t) at;
+            float t = float(at - frame);
+            size_t next = std::min(frame + 1, frames - 1);
+            for (int channel = 0; channel < MIX_CHANNELS; channel++)
+            {
+                sound.samples[i * MIX_CHANNELS + channel] = sample(frame, channel) * (1 - t) + sample(next, channel) * t;
+            }
+        }
+        return sound;
+    }
+};
+
+// Names a playing voice. Once the voice finishes or is taken over the handle goes stale
+struct VoiceHandle
+{
+    static constexpr uint16_t NONE = UINT16_MAX;
+    uint16_t index = NONE;
+    uint16_t generation = 0;
+
+    explicit operator bool() const
+    {
+        return index != NONE;
+    }
+};
+
+// How a kind of sound competes for voices
+struct SoundRule
+{
+    // When every voice is busy a sound takes over the oldest one of the lowest priority at or below its own
+    int priority = 0;
+    // Instances of the sound at once, one more takes over the oldest
+    int limit = 1;
+    float volume = 1;
+};
+
+// Mixes sounds on a fixed number of voices. Volumes only ever move in ramps, voices that stop or are taken
+// over fade out in DECLICK frames while the new sound already starts. Main thread only.
+class Mixer
+{
+public:
+    static constexpr int VOICES = 8;
+    static constexpr int DECLICK = 256;
+
+    // For when the sounds are played by something that can't stop them once started, like tako, and the mixer only
+    // follows along with Advance. Nothing is taken over, stopped or ramped then: Play refuses a sound that would
+    // need a busy voice, so no more than VOICES sounds and no more than a rule's limit of one sound play at once
+    void PlayElsewhere(bool elsewhere)
+    {
+        m_elsewhere = elsewhere;
+    }
+
+    // Nothing when every voice is busy with something more important
+    VoiceHandle Play(const Sound* sound, const SoundRule& rule, bool loop = false, float fadeIn = 0)
+    {
+        if (!sound || sound->Frames() == 0)
+        {
+            return {};
+        }
+        int instances = 0;
+        int victim = -1;
+        for (int i = 0; i < VOICES; i++)
+        {
+            auto& voice = m_voices[i];
+            if (voice.main.sound == sound && !voice.main.stopping)
+            {
+                instances++;
+                if (victim < 0 || voice.started < m_voices[victim].started)
+                {
+                    victim = i;
+                }
+            }
+        }
+        if (m_elsewhere && instances >= rule.limit)
+        {
+            return {};
+        }
+        if (instances < rule.limit)
+        {
+            victim = Free();
+        }
+        if (victim < 0 && !m_elsewhere)
+        {
+            victim = Weakest(rule.priority);
+        }
+        if (victim < 0)
+        {
+            return {};
+        }
+
+        auto& voice = m_voices[victim];
+        if (voice.main.sound)
+        {
+            voice.tail = voice.main;
+            voice.tail.RampTo(0, DECLICK, true);
+        }
+        voice.main = {};
+        voice.main.sound = sound;
+        voice.main.loop = loop;
+        voice.main.gain = fadeIn > 0 ? 0 : rule.volume;
+        voice.main.RampTo(rule.volume, Frames(fadeIn), false);
+        voice.priority = rule.priority;
+        voice.started = ++m_started;
+        voice.generation++;
+        return { uint16_t(victim), voice.generation };
+    }
+
+    void Stop(VoiceHandle handle, float fadeOut = 0)
+    {
+        if (auto voice = m_elsewhere ? nullptr : Find(handle))
+        {
+            voice->main.RampTo(0, std::max(DECLICK, Frames(fadeOut)), true);
+        }
+    }
+
+    // Moves the voice's volume to volume over seconds
+    void Ramp(VoiceHandle handle, float volume, float seconds)
+    {
+        auto voice = m_elsewhere ? nullptr : Find(handle);
+        if (voice && !voice->main.stopping)
+        {
+            voice->main.RampTo(volume, Frames(seconds), false);
+        }
+    }
+
+    bool Playing(VoiceHandle handle) const
+    {
+        return const_cast<Mixer*>(this)->Find(handle) != nullptr;
+    }
+
+    int Active() const
+    {
+        return (int) std::count_if(m_voices.begin(), m_voices.end(), [](const Voice& voice) { return voice.main.sound != nullptr; });
+    }
+
+    // Overwrites out with the next frames of every voice, stereo interleaved
+    void Render(float* out, size_t frames)
+    {
+        std::fill(out, out + frames * MIX_CHANNELS, 0.0f);
+        Run(out, frames);
+    }
+
+    // Lets time pass without making samples, for when the sounds are played by something else
+    void Advance(float seconds)
+    {
+        m_carry += seconds * MIX_RATE;
+        auto frames = (size_t) m_carry;
+        m_carry -= frames;
+        Run(nullptr, frames);
+    }
+
+    // Clamped to full scale
+    static void ToPcm16(const float* in, int16_t* out, size_t count)
+    {
+        size_t i = 0;
+#ifdef MIXER_SSE
+        const __m128 scale = _mm_set1_ps(32767.0f);
+        const __m128 high = _mm_set1_ps(1.0f);
+        const __m128 low = _mm_set1_ps(-1.0f);
+        for (; i + 8 <= count; i += 8)
+        {
+            __m128 a = _mm_max_ps(low, _mm_min_ps(high, _mm_loadu_ps(in + i)));
+            __m128 b = _mm_max_ps(low, _mm_min_ps(high, _mm_loadu_ps(in + i + 4)));
+            __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(_mm_mul_ps(a, scale)), _mm_cvtps_epi32(_mm_mul_ps(b, scale)));
+            _mm_storeu_si128((__m128i*) (out + i), packed);
+        }
+#endif
+        for (; i < count; i++)
+        {
+            out[i] = (int16_t) std::lrint(std::clamp(in[i], -1.0f, 1.0f) * 32767.0f);
+        }
+    }
+private:
+    struct Stream
+    {
+        const Sound* sound = nullptr;
+        size_t position = 0;
+        bool loop = false;
+        float gain = 0;
+        float target = 0;
+        float step = 0;
+        int rampLeft = 0;
+        // Ends when the ramp reaches silence
+        bool stopping = false;
+
+        void RampTo(float volume, int frames, bool stop)
+        {
+            stopping = stop;
+            target = volume;
+            rampLeft = std::max(1, frames);
+            step = (target - gain) / rampLeft;
+        }
+    };
+
+    struct Voice
+    {
+        Stream main;
+        // What the voice played before it was taken over, fading out
+        Stream tail;
+        int priority = 0;
+        uint64_t started = 0;
+        uint16_t generation = 0;
+    };
+
+    std::array<Voice, VOICES> m_voices;
+    uint64_t m_started = 0;
+    double m_carry = 0;
+    bool m_elsewhere = false;
+
+    static int Frames(float seconds)
+    {
+        return (int) (seconds * MIX_RATE);
+    }
+
+    Voice* Find(VoiceHandle handle)
+    {
+        if (handle.index >= VOICES)
+        {
+            return nullptr;
+        }
+        auto& voice = m_voices[handle.index];
+        return voice.main.sound && voice.generation == handle.generation ? &voice : nullptr;
+    }
+
+    int Free() const
+    {
+        for (int i = 0; i < VOICES; i++)
+        {
+            if (!m_voices[i].main.sound)
+            {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    // Voices on their way out go first
+    int Weakest(int priority) const
+    {
+        int weakest = -1;
+        auto rank = [](const Voice& voice) { return voice.main.stopping ? INT32_MIN : voice.priority; };
+        for (int i = 0; i < VOICES; i++)
+        {
+            auto& voice = m_voices[i];
+            if (rank(voice) > priority)
+            {
+                continue;
+            }
+            if (weakest < 0 || rank(voice) < rank(m_voices[weakest]) ||
+                (rank(voice) == rank(m_voices[weakest]) && voice.started < m_voices[weakest].started))
+            {
+                weakest = i;
+            }
+        }
+        return weakest;
+    }
+
+    void Run(float* out, size_t frames)
+    {
+        for (auto& voice : m_voices)
+        {
+            Play(voice.tail, out, frames);
+            Play(voice.main, out, frames);
+        }
+    }
+
+    // Spans end where the sound or the ramp does, so the gain steps evenly inside each one
+    static void Play(Stream& stream, float* out, size_t frames)
+    {
+        size_t done = 0;
+        while (stream.sound && done < frames)
+        {
+            size_t span = std::min(frames - done, stream.sound->Frames() - stream.position);
+            if (stream.rampLeft > 0)
+            {
+                span = std::min<size_t>(span, stream.rampLeft);
+            }
+            if (out)
+            {
+                Mix(out + done * MIX_CHANNELS, stream.sound->samples.data() + stream.position * MIX_CHANNELS, span, stream.gain, stream.step);
+            }
+            done += span;
+            stream.position += span;
+            stream.gain += stream.step * span;
+            if (stream.rampLeft > 0 && (stream.rampLeft -= (int) span) == 0)
+            {
+                stream.gain = stream.target;
+                stream.step = 0;
+                if (stream.stopping)
+                {
+                    stream.sound = nullptr;
+                }
+            }
+            if (stream.sound && stream.position == stream.sound->Frames())
+            {
+                stream.position = 0;
+                if (!stream.loop)
+                {
+                    stream.sound = nullptr;
+                }
+            }
+        }
+    }
+
+    static void Mix(float* out, const float* in, size_t frames, float gain, float step)
+    {
+        size_t i = 0;
+#ifdef MIXER_SSE
+        // Two stereo frames at a time, both channels of a frame share their gain
+        __m128 gains = _mm_set_ps(gain + step, gain + step, gain, gain);
+        const __m128 steps = _mm_set1_ps(2 * step);
+        for (; i + 2 <= frames; i += 2)
+        {
+            __m128 mixed = _mm_add_ps(_mm_loadu_ps(out + i * MIX_CHANNELS), _mm_mul_ps(_mm_loadu_ps(in + i * MIX_CHANNELS), gains));
+            _mm_storeu_ps(out + i * MIX_CHANNELS, mixed);
+            gains = _mm_add_ps(gains, steps);
+        }
+        gain += step * i;
+#endif
+        for (; i < frames; i++, gain += step)
+        {
+            out[i * MIX_CHANNELS] += in[i * MIX_CHANNELS] * gain;
+            out[i * MIX_CHANNELS + 1] += in[i * MIX_CHANNELS + 1] * gain;
+        }
+    }
+};
+
+// Writes 16 bit stereo at MIX_RATE, the sizes in the header are filled in on Close
+class WavWriter
+{
+public:
+    ~WavWriter()
+    {
+        Close();
+    }
+
+    bool Open(const char* file)
+    {
+        Close();
+        m_file = std::fopen(file, "wb");
+        m_bytes = 0;
+        if (m_file)
+        {
+            Header();
+        }
+        return m_file != nullptr;
+    }
+
+    void Write(const int16_t* samples, size_t count)
+    {
+        if (!m_file)
+        {
+            return;
+        }
+        // WAV is little endian like every platform this runs on
+        std::fwrite(samples, sizeof(int16_t), count, m_file);
+        m_bytes += uint32_t(count * sizeof(int16_t));
+    }
+
+    void Close()
+    {
+        if (!m_file)
+        {
+            return;
+        }
+        std::fseek(m_file, 0, SEEK_SET);
+        Header();
+        std::fclose(m_file);
+        m_file = nullptr;
+    }
+private:
+    std::FILE* m_file = nullptr;
+    uint32_t m_bytes = 0;
+
+    void Header()
+    {
+        auto u16 = [&](uint16_t v) { std::fwrite(&v, sizeof(v), 1, m_file); };
+        auto u32 = [&](uint32_t v) { std::fwrite(&v, sizeof(v), 1, m_file); };
+        std::fwrite("RIFF", 1, 4, m_file);
+        u32(36 + m_bytes);
+        std::fwrite("WAVEfmt ", 1, 8, m_file);
+        u32(16);
+        u16(1);
+        u16(MIX_CHANNELS);
+        u32(MIX_RATE);
+        u32(MIX_RATE * MIX_CHANNELS * sizeof(int16_t));
+        u16(MIX_CHANNELS * sizeof(int16_t));
+        u16(16);
+        std::fwrite("data", 1, 4, m_file);
+        u32(m_bytes);
+    }
+};
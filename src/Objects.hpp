@@ -23,8 +23,47 @@ struct Parsnip
     int harvestDay;
 };
 
+enum class ItemType
+{
+    None,
+    WateringCan,
+    SeedBag,
+    Parsnip,
+    Count
+};
+
+enum class ItemState
+{
+    Stored,
+    Placed,
+    Held
+};
+
+// Set when an item is spawned, so nothing has to test its components to know what it is
+struct Item
+{
+    ItemType type;
+    ItemState state;
+};
+
+constexpr ItemType ItemTypeOf(const WateringCan&) { return ItemType::WateringCan; }
+constexpr ItemType ItemTypeOf(const SeedBag&) { return ItemType::SeedBag; }
+constexpr ItemType ItemTypeOf(const Parsnip&) { return ItemType::Parsnip; }
+
+enum class TargetType
+{
+    Ground,
+    Well,
+    TransportBox,
+    Count
+};
+
+constexpr TargetType TargetTypeOf(const Well&) { return TargetType::Well; }
+constexpr TargetType TargetTypeOf(const TransportBox&) { return TargetType::TransportBox; }
+
 struct Interactable
 {
     float w;
     float h;
+    TargetType type;
 };
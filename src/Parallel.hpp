@@ -0,0 +1,331 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Parallel
+{
+    using Job = std::function<void()>;
+
+    // Work stealing scheduler, every thread owns a deque and takes from its back while idle threads steal from the front.
+    // The main thread is the one that created it until another binds itself. It only works while waiting and is the only
+    // one running main thread jobs, its deque is shared with any other thread that isn't a worker.
+    class Scheduler
+    {
+    public:
+        Scheduler() : m_mainThread(std::this_thread::get_id())
+        {
+            unsigned count = 1;
+#ifndef __EMSCRIPTEN__
+            count = std::max(1u, std::thread::hardware_concurrency());
+#endif
+            m_queues.reserve(count);
+            for (unsigned i = 0; i < count; i++)
+            {
+                m_queues.push_back(std::make_unique<Queue>());
+            }
+            for (unsigned i = 1; i < count; i++)
+            {
+                m_threads.emplace_back([this, i] { Work(i); });
+            }
+        }
+
+        ~Scheduler()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_sleepMutex);
+                m_quit = true;
+            }
+            m_wake.notify_all();
+            for (auto& thread : m_threads)
+            {
+                thread.join();
+            }
+        }
+
+        int Threads() const
+        {
+            return m_queues.size();
+        }
+
+        bool OnMainThread() const
+        {
+            return m_mainThread.load() == std::this_thread::get_id();
+        }
+
+        // Makes thread the main thread, for the thread that owns the world when that isn't the one that started
+        // the scheduler. Only while no graph is running, returns the one before to hand it back
+        std::thread::id BindMainThread(std::thread::id thread = std::this_thread::get_id())
+        {
+            return m_mainThread.exchange(thread);
+        }
+
+        // Queues job and decrements counter once it ran
+        void Submit(Job job, std::atomic<int>* counter, bool mainThread = false)
+        {
+            Task task = { std::move(job), counter };
+            if (mainThread)
+            {
+                std::lock_guard<std::mutex> lock(m_mainMutex);
+                m_mainQueue.push_back(std::move(task));
+            }
+            else
+            {
+                auto& queue = *m_queues[t_worker >= 0 ? t_worker : 0];
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                queue.tasks.push_back(std::move(task));
+            }
+            m_queued++;
+            if (m_sleeping > 0)
+            {
+                std::lock_guard<std::mutex> lock(m_sleepMutex);
+                m_wake.notify_all();
+            }
+        }
+
+        // Runs other jobs on this thread until counter reaches zero, sleeping while there is nothing to take
+        void Wait(std::atomic<int>& counter)
+        {
+            while (counter > 0)
+            {
+                Task task;
+                if (TryTake(task))
+                {
+                    Execute(task);
+                    continue;
+                }
+                std::unique_lock<std::mutex> lock(m_sleepMutex);
+                m_sleeping++;
+                m_wake.wait(lock, [&] { return counter == 0 || HasWork(); });
+                m_sleeping--;
+            }
+        }
+    private:
+        struct Task
+        {
+            Job job;
+            std::atomic<int>* counter = nullptr;
+        };
+
+        struct Queue
+        {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        static inline thread_local int t_worker = -1;
+        std::atomic<std::thread::id> m_mainThread;
+
+        std::vector<std::unique_ptr<Queue>> m_queues;
+        std::vector<std::thread> m_threads;
+        std::mutex m_mainMutex;
+        std::deque<Task> m_mainQueue;
+        std::atomic<int> m_queued = 0;
+        std::atomic<int> m_sleeping = 0;
+        std::mutex m_sleepMutex;
+        std::condition_variable m_wake;
+        bool m_quit = false;
+
+        bool TryTake(Task& task)
+        {
+            if (m_queued == 0)
+            {
+                return false;
+            }
+            int self = std::max(t_worker, 0);
+            if (OnMainThread())
+            {
+                std::lock_guard<std::mutex> lock(m_mainMutex);
+                if (!m_mainQueue.empty())
+                {
+                    task = std::move(m_mainQueue.front());
+                    m_mainQueue.pop_front();
+                    m_queued--;
+                    return true;
+                }
+            }
+            {
+                auto& own = *m_queues[self];
+                std::lock_guard<std::mutex> lock(own.mutex);
+                if (!own.tasks.empty())
+                {
+                    task = std::move(own.tasks.back());
+                    own.tasks.pop_back();
+                    m_queued--;
+                    return true;
+                }
+            }
+            for (size_t i = 1; i < m_queues.size(); i++)
+            {
+                auto& victim = *m_queues[(self + i) % m_queues.size()];
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (!victim.tasks.empty())
+                {
+                    task = std::move(victim.tasks.front());
+                    victim.tasks.pop_front();
+                    m_queued--;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void Execute(Task& task)
+        {
+            task.job();
+            // Whoever waits on the counter may be asleep, the counter itself may be gone once it reaches zero
+            if (task.counter && --(*task.counter) == 0 && m_sleeping > 0)
+            {
+                std::lock_guard<std::mutex> lock(m_sleepMutex);
+                m_wake.notify_all();
+            }
+        }
+
+        // Main thread jobs are queued too, only the main thread wakes up for those
+        bool HasWork()
+        {
+            std::lock_guard<std::mutex> mainLock(m_mainMutex);
+            return m_queued > (OnMainThread() ? 0 : (int) m_mainQueue.size());
+        }
+
+        void Work(int index)
+        {
+            t_worker = index;
+            while (true)
+            {
+                Task task;
+                if (TryTake(task))
+                {
+                    Execute(task);
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> lock(m_sleepMutex);
+                m_sleeping++;
+                m_wake.wait(lock, [&] { return m_quit || HasWork(); });
+                m_sleeping--;
+                if (m_quit)
+                {
+                    return;
+                }
+            }
+        }
+    };
+
+    inline Scheduler& GetScheduler()
+    {
+        static Scheduler scheduler;
+        return scheduler;
+    }
+
+    // Splits [0, count) into ranges of at least grain elements and runs fn(begin, end) on each
+    template<class F>
+    void For(int count, int grain, F&& fn)
+    {
+        auto& scheduler = GetScheduler();
+        int chunks = std::min((count + grain - 1) / std::max(grain, 1), scheduler.Threads() * 4);
+        if (chunks <= 1)
+        {
+            if (count > 0)
+            {
+                fn(0, count);
+            }
+            return;
+        }
+
+        std::atomic<int> pending = chunks;
+        for (int chunk = 0; chunk < chunks; chunk++)
+        {
+            int begin = (int) ((long long) count * chunk / chunks);
+            int end = (int) ((long long) count * (chunk + 1) / chunks);
+            scheduler.Submit([&fn, begin, end] { fn(begin, end); }, &pending);
+        }
+        scheduler.Wait(pending);
+    }
+
+    // Jobs of one frame, each starts once everything it depends on finished
+    class Graph
+    {
+    public:
+        using Node = int;
+
+        Node Add(Job job, std::initializer_list<Node> dependsOn = {}, bool mainThread = false)
+        {
+            Node node = m_nodes.size();
+            m_nodes.push_back({ std::move(job), {}, (int) dependsOn.size(), mainThread });
+            for (auto dependency : dependsOn)
+            {
+                m_nodes[dependency].successors.push_back(node);
+            }
+            return node;
+        }
+
+        Node AddMain(Job job, std::initializer_list<Node> dependsOn = {})
+        {
+            return Add(std::move(job), dependsOn, true);
+        }
+
+        // Returns once every node ran. Off the main thread, like a game stepped in a batch, the nodes run one
+        // after another in the order they were added, which respects every dependency. A game updating on its
+        // own thread binds that thread as the main thread to keep its phases parallel
+        void Run()
+        {
+            auto& scheduler = GetScheduler();
+            if (!scheduler.OnMainThread())
+            {
+                for (auto& node : m_nodes)
+                {
+                    node.job();
+                }
+                return;
+            }
+            m_remaining = m_nodes.size();
+            m_pending = std::make_unique<std::atomic<int>[]>(m_nodes.size());
+            for (size_t i = 0; i < m_nodes.size(); i++)
+            {
+                m_pending[i] = m_nodes[i].dependencies;
+            }
+            for (size_t i = 0; i < m_nodes.size(); i++)
+            {
+                if (m_nodes[i].dependencies == 0)
+                {
+                    Schedule(scheduler, i);
+                }
+            }
+            scheduler.Wait(m_remaining);
+        }
+    private:
+        struct NodeInfo
+        {
+            Job job;
+            std::vector<Node> successors;
+            int dependencies;
+            bool mainThread;
+        };
+
+        std::vector<NodeInfo> m_nodes;
+        std::unique_ptr<std::atomic<int>[]> m_pending;
+        std::atomic<int> m_remaining = 0;
+
+        void Schedule(Scheduler& scheduler, Node node)
+        {
+            scheduler.Submit([this, &scheduler, node]
+            {
+                m_nodes[node].job();
+                for (auto successor : m_nodes[node].successors)
+                {
+                    if (--m_pending[successor] == 0)
+                    {
+                        Schedule(scheduler, successor);
+                    }
+                }
+            }, &m_remaining, m_nodes[node].mainThread);
+        }
+    };
+}
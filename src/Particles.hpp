@@ -0,0 +1,163 @@
+#pragma once
+#include "Tako.hpp"
+#include "Rect.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PARTICLES_SSE
+#endif
+
+// How one kind of effect throws its particles
+struct ParticleBurst
+{
+    int count;
+    // Furthest a particle flies sideways or up and down per second, picked at random for each
+    float speed;
+    // Added upwards on top, so a burst can fountain up or drift
+    float lift;
+    // Downwards, negative floats up
+    float gravity;
+    // Seconds, each particle lives between half and all of it
+    float life;
+    float size;
+    tako::Color color;
+};
+
+struct ParticleDraw
+{
+    float x;
+    float y;
+    float size;
+    tako::Color color;
+};
+
+// Specks thrown off by work on the farm, purely for show. Kept as separate arrays so a step over tens of thousands
+// is a few loops of packed math. Memory for all CAPACITY is taken at the first burst, dead particles are swapped
+// out for the last live one and a full pool drops new particles.
+class Particles
+{
+public:
+    static constexpr size_t CAPACITY = 1 << 16;
+
+    void Emit(const ParticleBurst& burst, tako::Vector2 origin)
+    {
+        if (m_x.empty())
+        {
+            for (auto array : {&m_x, &m_y, &m_vx, &m_vy, &m_gravity, &m_life, &m_lifetime, &m_size})
+            {
+                array->resize(CAPACITY);
+            }
+            m_color.resize(CAPACITY);
+        }
+        size_t count = std::min(CAPACITY - m_count, (size_t) burst.count);
+        for (size_t i = m_count; i < m_count + count; i++)
+        {
+            m_x[i] = origin.x;
+            m_y[i] = origin.y;
+            m_vx[i] = (Random() * 2 - 1) * burst.speed;
+            m_vy[i] = (Random() * 2 - 1) * burst.speed + burst.lift;
+            m_gravity[i] = burst.gravity;
+            m_lifetime[i] = m_life[i] = burst.life * (0.5f + Random() * 0.5f);
+            m_size[i] = burst.size;
+            m_color[i] = burst.color;
+        }
+        m_count += count;
+    }
+
+    void Step(float dt)
+    {
+        size_t i = 0;
+#ifdef PARTICLES_SSE
+        const __m128 step = _mm_set1_ps(dt);
+        for (; i + 4 <= m_count; i += 4)
+        {
+            __m128 vy = _mm_sub_ps(_mm_loadu_ps(&m_vy[i]), _mm_mul_ps(_mm_loadu_ps(&m_gravity[i]), step));
+            _mm_storeu_ps(&m_vy[i], vy);
+            _mm_storeu_ps(&m_y[i], _mm_add_ps(_mm_loadu_ps(&m_y[i]), _mm_mul_ps(vy, step)));
+            _mm_storeu_ps(&m_x[i], _mm_add_ps(_mm_loadu_ps(&m_x[i]), _mm_mul_ps(_mm_loadu_ps(&m_vx[i]), step)));
+            _mm_storeu_ps(&m_life[i], _mm_sub_ps(_mm_loadu_ps(&m_life[i]), step));
+        }
+#endif
+        for (; i < m_count; i++)
+        {
+            m_vy[i] -= m_gravity[i] * dt;
+            m_y[i] += m_vy[i] * dt;
+            m_x[i] += m_vx[i] * dt;
+            m_life[i] -= dt;
+        }
+
+        for (i = 0; i < m_count;)
+        {
+            if (m_life[i] > 0)
+            {
+                i++;
+                continue;
+            }
+            m_count--;
+            m_x[i] = m_x[m_count];
+            m_y[i] = m_y[m_count];
+            m_vx[i] = m_vx[m_count];
+            m_vy[i] = m_vy[m_count];
+            m_gravity[i] = m_gravity[m_count];
+            m_life[i] = m_life[m_count];
+            m_lifetime[i] = m_lifetime[m_count];
+            m_size[i] = m_size[m_count];
+            m_color[i] = m_color[m_count];
+        }
+    }
+
+    // Appends the particles inside view, tinted by light and fading out as they age
+    void Gather(Rect view, tako::Color light, std::vector<ParticleDraw>& out) const
+    {
+        float left = view.Left();
+        float right = view.Right();
+        float bottom = view.Bottom();
+        float top = view.Top();
+        for (size_t i = 0; i < m_count; i++)
+        {
+            if (m_x[i] < left || m_x[i] > right || m_y[i] < bottom || m_y[i] > top)
+            {
+                continue;
+            }
+            auto color = m_color[i];
+            color.r = color.r * light.r / 255;
+            color.g = color.g * light.g / 255;
+            color.b = color.b * light.b / 255;
+            color.a = uint8_t(color.a * light.a / 255 * std::min(1.0f, m_life[i] / m_lifetime[i]));
+            out.push_back({m_x[i], m_y[i], m_size[i], color});
+        }
+    }
+
+    size_t Count() const
+    {
+        return m_count;
+    }
+
+    void Clear()
+    {
+        m_count = 0;
+    }
+private:
+    std::vector<float> m_x;
+    std::vector<float> m_y;
+    std::vector<float> m_vx;
+    std::vector<float> m_vy;
+    std::vector<float> m_gravity;
+    std::vector<float> m_life;
+    std::vector<float> m_lifetime;
+    std::vector<float> m_size;
+    std::vector<tako::Color> m_color;
+    size_t m_count = 0;
+    uint32_t m_seed = 0x9E3779B9;
+
+    // Looks only need to vary, xorshift in [0, 1)
+    float Random()
+    {
+        m_seed ^= m_seed << 13;
+        m_seed ^= m_seed >> 17;
+        m_seed ^= m_seed << 5;
+        return (m_seed >> 8) / float(1 << 24);
+    }
+};
@@ -9,12 +9,27 @@ struct RigidBody
 {
     tako::Vector2 size;
     tako::Entity entity;
+    bool enabled = true;
+    // Players share the spawn, two such bodies that overlap walk apart instead of being stuck in each other
+    bool walksApart = false;
 };
 
 namespace Physics
 {
     void Move(tako::World& world, Level& level, Position& pos, RigidBody& rigid, tako::Vector2 movement)
     {
+        // Nothing else moves meanwhile, so the other bodies are gathered once
+        RectBatch others;
+        Rect self = {pos.AsVec(), rigid.size};
+        world.IterateComps<Position, RigidBody>([&](Position& otherPos, RigidBody& otherRigid)
+        {
+            Rect other = {otherPos.AsVec(), otherRigid.size};
+            bool apart = rigid.walksApart && otherRigid.walksApart && Rect::Overlap(self, other);
+            if (&rigid != &otherRigid && otherRigid.enabled && !apart)
+            {
+                others.Add(other);
+            }
+        });
         while ((tako::mathf::abs(movement.x) > 0.0000001f || tako::mathf::abs(movement.y) > 0.0000001f))
         {
 
@@ -39,38 +54,55 @@ namespace Physics
                 movement -= mov / 2;
                 continue;
             }
-            auto bump = false;
-            world.IterateComps<Position, RigidBody>([&](Position& otherPos, RigidBody& otherRigid)
+            int bump = others.FirstOverlap(newPos);
+            if (bump >= 0)
             {
-                if (bump)
+                if (others.Overlaps(bump, {{pos.x + mov.x, pos.y}, rigid.size}))
                 {
-                    return;
+                    movement.x -= mov.x / 2;
                 }
-                if (&rigid == &otherRigid)
+                if (others.Overlaps(bump, {{pos.x, pos.y + mov.y}, rigid.size}))
                 {
-                    return;
+                    movement.y -= mov.y / 2;
                 }
 
-                Rect other = {otherPos.AsVec(), otherRigid.size};
-                if (Rect::Overlap(newPos, other))
-                {
-                    if (Rect::Overlap({{pos.x + mov.x, pos.y}, rigid.size}, other))
-                    {
-                        movement.x -= mov.x / 2;
-                    }
-                    if (Rect::Overlap({{pos.x, pos.y + mov.y}, rigid.size}, other))
-                    {
-                        movement.y -= mov.y / 2;
-                    }
+                movement -= mov / 2;
+                continue;
+            }
+            movement -= mov;
+            pos += mov;
+        }
+    }
 
-                    movement -= mov / 2;
-                    bump = true;
-                    return;
+    // Same stepping as Move but only against the level, so it only reads shared state
+    tako::Vector2 SweepLevel(Level& level, tako::Vector2 pos, tako::Vector2 size, tako::Vector2 movement)
+    {
+        while ((tako::mathf::abs(movement.x) > 0.0000001f || tako::mathf::abs(movement.y) > 0.0000001f))
+        {
+            auto mov = movement;
+            if (movement.magnitude() > 1)
+            {
+                mov.normalize();
+            }
+
+            if (level.Overlap({pos + mov, size}))
+            {
+                if (level.Overlap({{pos.x + mov.x, pos.y}, size}))
+                {
+                    movement.x -= mov.x / 2;
                 }
-            });
-            if (bump) continue;
+                if (level.Overlap({{pos.x, pos.y + mov.y}, size}))
+                {
+                    movement.y -= mov.y / 2;
+                }
+
+                movement -= mov / 2;
+                continue;
+            }
             movement -= mov;
             pos += mov;
         }
+
+        return pos;
     }
 }
\ No newline at end of file
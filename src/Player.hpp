@@ -2,9 +2,23 @@
 #include "Tako.hpp"
 #include <optional>
 
+// Players on one farm, the host's own is slot 0
+constexpr int MAX_PLAYERS = 4;
+
 struct Player
 {
     tako::Vector2 facing;
     std::optional<tako::Entity> heldObject;
     bool wasMoving;
+    // Whose controls move this player
+    int slot = 0;
+};
+
+// What the player asks for this frame, read from the keys or decided by the bot
+struct Controls
+{
+    tako::Vector2 move;
+    bool pickup = false;
+    bool use = false;
+    bool skipDay = false;
 };
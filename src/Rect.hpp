@@ -1,5 +1,17 @@
 #pragma once
 #include "Math.hpp"
+#include "Bits.hpp"
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define RECT_BATCH_SSE
+#endif
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
 
 struct Rect
 {
@@ -60,3 +72,175 @@ struct Rect
         return std::abs(a.y - b.y) < a.h / 2 + b.h / 2;
     }
 };
+
+// Many rects as separate arrays of centers and half sizes, one rect or point is tested against
+// a whole block of them per instruction. Same results as the Rect tests one pair at a time.
+class RectBatch
+{
+public:
+    // Padding to a whole block with rects that never hit
+    static constexpr size_t BLOCK = 8;
+
+    void Clear()
+    {
+        m_x.clear();
+        m_y.clear();
+        m_halfW.clear();
+        m_halfH.clear();
+        m_size = 0;
+    }
+
+    size_t Size() const
+    {
+        return m_size;
+    }
+
+    void Add(Rect rect)
+    {
+        if (m_size == m_x.size())
+        {
+            constexpr float never = -std::numeric_limits<float>::infinity();
+            m_x.resize(m_size + BLOCK, 0);
+            m_y.resize(m_size + BLOCK, 0);
+            m_halfW.resize(m_size + BLOCK, never);
+            m_halfH.resize(m_size + BLOCK, never);
+        }
+        Set(m_size++, rect);
+    }
+
+    void Set(size_t i, Rect rect)
+    {
+        m_x[i] = rect.x;
+        m_y[i] = rect.y;
+        m_halfW[i] = rect.w / 2;
+        m_halfH[i] = rect.h / 2;
+    }
+
+    bool Overlaps(size_t i, Rect rect) const
+    {
+        return std::abs(rect.x - m_x[i]) < rect.w / 2 + m_halfW[i] && std::abs(rect.y - m_y[i]) < rect.h / 2 + m_halfH[i];
+    }
+
+    // Index of the first rect overlapping rect that accept takes, or -1
+    template<class F>
+    int FindOverlap(Rect rect, F accept) const
+    {
+        float halfW = rect.w / 2;
+        float halfH = rect.h / 2;
+        return Find(accept, [&](size_t base)
+        {
+            return OverlapMask(base, rect.x, rect.y, halfW, halfH);
+        });
+    }
+
+    int FirstOverlap(Rect rect) const
+    {
+        return FindOverlap(rect, [](size_t) { return true; });
+    }
+
+    // Index of the first rect the point is inside of, edges included, or -1
+    int FirstContaining(float px, float py) const
+    {
+        return Find([](size_t) { return true; }, [&](size_t base)
+        {
+            return PointMask(base, px, py);
+        });
+    }
+private:
+    std::vector<float> m_x;
+    std::vector<float> m_y;
+    std::vector<float> m_halfW;
+    std::vector<float> m_halfH;
+    size_t m_size = 0;
+
+    template<class F, class M>
+    int Find(F accept, M mask) const
+    {
+        for (size_t base = 0; base < m_size; base += BLOCK)
+        {
+            for (uint64_t hits = mask(base); hits; hits &= hits - 1)
+            {
+                size_t i = base + LowestBit(hits);
+                if (accept(i))
+                {
+                    return (int) i;
+                }
+            }
+        }
+        return -1;
+    }
+
+    // One bit per rect of the block starting at base
+    uint64_t OverlapMask(size_t base, float x, float y, float halfW, float halfH) const
+    {
+#if defined(__AVX__)
+        const __m256 sign = _mm256_set1_ps(-0.0f);
+        __m256 dx = _mm256_andnot_ps(sign, _mm256_sub_ps(_mm256_set1_ps(x), _mm256_loadu_ps(&m_x[base])));
+        __m256 dy = _mm256_andnot_ps(sign, _mm256_sub_ps(_mm256_set1_ps(y), _mm256_loadu_ps(&m_y[base])));
+        __m256 inX = _mm256_cmp_ps(dx, _mm256_add_ps(_mm256_set1_ps(halfW), _mm256_loadu_ps(&m_halfW[base])), _CMP_LT_OQ);
+        __m256 inY = _mm256_cmp_ps(dy, _mm256_add_ps(_mm256_set1_ps(halfH), _mm256_loadu_ps(&m_halfH[base])), _CMP_LT_OQ);
+        return (uint64_t) _mm256_movemask_ps(_mm256_and_ps(inX, inY));
+#elif defined(RECT_BATCH_SSE)
+        const __m128 sign = _mm_set1_ps(-0.0f);
+        uint64_t mask = 0;
+        for (size_t half = 0; half < BLOCK; half += 4)
+        {
+            size_t i = base + half;
+            __m128 dx = _mm_andnot_ps(sign, _mm_sub_ps(_mm_set1_ps(x), _mm_loadu_ps(&m_x[i])));
+            __m128 dy = _mm_andnot_ps(sign, _mm_sub_ps(_mm_set1_ps(y), _mm_loadu_ps(&m_y[i])));
+            __m128 inX = _mm_cmplt_ps(dx, _mm_add_ps(_mm_set1_ps(halfW), _mm_loadu_ps(&m_halfW[i])));
+            __m128 inY = _mm_cmplt_ps(dy, _mm_add_ps(_mm_set1_ps(halfH), _mm_loadu_ps(&m_halfH[i])));
+            mask |= (uint64_t) _mm_movemask_ps(_mm_and_ps(inX, inY)) << half;
+        }
+        return mask;
+#else
+        uint64_t mask = 0;
+        for (size_t i = 0; i < BLOCK; i++)
+        {
+            bool hit = std::abs(x - m_x[base + i]) < halfW + m_halfW[base + i] && std::abs(y - m_y[base + i]) < halfH + m_halfH[base + i];
+            mask |= (uint64_t) hit << i;
+        }
+        return mask;
+#endif
+    }
+
+    uint64_t PointMask(size_t base, float px, float py) const
+    {
+#if defined(__AVX__)
+        __m256 x = _mm256_loadu_ps(&m_x[base]);
+        __m256 y = _mm256_loadu_ps(&m_y[base]);
+        __m256 halfW = _mm256_loadu_ps(&m_halfW[base]);
+        __m256 halfH = _mm256_loadu_ps(&m_halfH[base]);
+        __m256 p = _mm256_set1_ps(px);
+        __m256 q = _mm256_set1_ps(py);
+        __m256 in = _mm256_and_ps(_mm256_cmp_ps(p, _mm256_sub_ps(x, halfW), _CMP_GE_OQ), _mm256_cmp_ps(p, _mm256_add_ps(x, halfW), _CMP_LE_OQ));
+        in = _mm256_and_ps(in, _mm256_and_ps(_mm256_cmp_ps(q, _mm256_add_ps(y, halfH), _CMP_LE_OQ), _mm256_cmp_ps(q, _mm256_sub_ps(y, halfH), _CMP_GE_OQ)));
+        return (uint64_t) _mm256_movemask_ps(in);
+#elif defined(RECT_BATCH_SSE)
+        uint64_t mask = 0;
+        for (size_t half = 0; half < BLOCK; half += 4)
+        {
+            size_t i = base + half;
+            __m128 x = _mm_loadu_ps(&m_x[i]);
+            __m128 y = _mm_loadu_ps(&m_y[i]);
+            __m128 halfW = _mm_loadu_ps(&m_halfW[i]);
+            __m128 halfH = _mm_loadu_ps(&m_halfH[i]);
+            __m128 p = _mm_set1_ps(px);
+            __m128 q = _mm_set1_ps(py);
+            __m128 in = _mm_and_ps(_mm_cmpge_ps(p, _mm_sub_ps(x, halfW)), _mm_cmple_ps(p, _mm_add_ps(x, halfW)));
+            in = _mm_and_ps(in, _mm_and_ps(_mm_cmple_ps(q, _mm_add_ps(y, halfH)), _mm_cmpge_ps(q, _mm_sub_ps(y, halfH))));
+            mask |= (uint64_t) _mm_movemask_ps(in) << half;
+        }
+        return mask;
+#else
+        uint64_t mask = 0;
+        for (size_t i = 0; i < BLOCK; i++)
+        {
+            size_t j = base + i;
+            bool hit = px >= m_x[j] - m_halfW[j] && px <= m_x[j] + m_halfW[j] && py <= m_y[j] + m_halfH[j] && py >= m_y[j] - m_halfH[j];
+            mask |= (uint64_t) hit << i;
+        }
+        return mask;
+#endif
+    }
+};
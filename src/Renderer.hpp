@@ -1,5 +1,6 @@
 #pragma once
 #include "Tako.hpp"
+#include "Graphics.hpp"
 
 struct RectangleRenderer
 {
@@ -10,7 +11,7 @@ struct RectangleRenderer
 struct SpriteRenderer
 {
     tako::Vector2 size;
-    tako::Sprite* sprite;
+    Gfx::Sprite* sprite;
     tako::Vector2 offset;
 };
 
@@ -19,9 +20,9 @@ struct AnimatedSprite
     float duration;
     float passed;
     int frames;
-    tako::Sprite** sprites;
+    Gfx::Sprite** sprites;
 
-    void SetStatic(tako::Sprite** sprite)
+    void SetStatic(Gfx::Sprite** sprite)
     {
         passed = 9999;
         duration = 9999;
@@ -29,7 +30,7 @@ struct AnimatedSprite
         sprites = sprite;
     }
 
-    void SetAnim(float duration, tako::Sprite** sprites, int frames)
+    void SetAnim(float duration, Gfx::Sprite** sprites, int frames)
     {
         this->duration = duration;
         passed = duration;
@@ -0,0 +1,601 @@
+#pragma once
+#include "Tako.hpp"
+#include "Actions.hpp"
+#include "Bits.hpp"
+#include "Chunk.hpp"
+#include "Events.hpp"
+#include "Player.hpp"
+#include "Transport.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Positions travel as whole quarter pixels
+constexpr float NET_UNITS_PER_PIXEL = 4;
+constexpr int NET_SLOT_BITS = 2;
+constexpr int NET_SCREEN_BITS = 2;
+constexpr int NET_DAY_BITS = 4;
+constexpr int NET_SPRITE_BITS = 5;
+constexpr int NET_LAYER_BITS = 2;
+constexpr int NET_TILE_BITS = 7;
+constexpr int NET_ACTION_BITS = (int) Action::Count;
+constexpr int NET_SOUND_BITS = (int) EventType::Count;
+static_assert(MAX_PLAYERS <= 1 << NET_SLOT_BITS);
+
+inline int32_t NetUnits(float pixels)
+{
+    return (int32_t) std::lround(pixels * NET_UNITS_PER_PIXEL);
+}
+
+inline float NetPixels(int32_t units)
+{
+    return units / NET_UNITS_PER_PIXEL;
+}
+
+// A sprite the way clients draw it, keyed by the entity it belongs to
+struct NetSprite
+{
+    uint32_t key = 0;
+    int32_t x = 0;
+    int32_t y = 0;
+    int32_t w = 0;
+    int32_t h = 0;
+    uint8_t sprite = 0;
+    // Lower layers are drawn first
+    uint8_t layer = 0;
+};
+
+// What one client sees on one tick. The tiles cover its view row by row, anything outside is unknown to it
+struct Snapshot
+{
+    uint32_t tick = 0;
+    uint8_t slot = 0;
+    uint8_t screen = 0;
+    uint8_t day = 0;
+    uint32_t parsnips = 0;
+    // Sixteenths of a second left of the day
+    uint32_t timeLeft = 0;
+    uint8_t held = 0;
+    // The newest input of this client the tick used
+    uint32_t inputAck = 0;
+    // Kinds of sounds made since the tick before. Not part of the delta, a sound is over once played
+    uint32_t sounds = 0;
+    int32_t cameraX = 0;
+    int32_t cameraY = 0;
+    TileArea area = {0, 0, -1, -1};
+    std::vector<uint8_t> tiles;
+    // Ordered by key
+    std::vector<NetSprite> sprites;
+
+    int Width() const
+    {
+        return area.x1 - area.x0 + 1;
+    }
+
+    bool Contains(int x, int y) const
+    {
+        return x >= area.x0 && x <= area.x1 && y >= area.y0 && y <= area.y1;
+    }
+
+    // Empty outside the area
+    uint8_t Tile(int x, int y) const
+    {
+        return Contains(x, y) ? tiles[(y - area.y0) * Width() + x - area.x0] : 0;
+    }
+};
+
+// Snapshots are sent as the difference to one the client confirmed, so what they cost follows what changed in
+// view rather than the size of the farm. Without a confirmed one the difference is to an empty snapshot.
+namespace Replication
+{
+    constexpr uint8_t CHANGED_POSITION = 1;
+    constexpr uint8_t CHANGED_SIZE = 2;
+    constexpr uint8_t CHANGED_SPRITE = 4;
+    constexpr uint8_t CHANGED_LAYER = 8;
+
+    inline const Snapshot& Empty()
+    {
+        static const Snapshot empty;
+        return empty;
+    }
+
+    inline std::vector<uint8_t> EncodeSnapshot(const Snapshot& snapshot, const Snapshot* baseline)
+    {
+        BitWriter out;
+        out.Write(snapshot.tick, 32);
+        out.WriteVar(baseline ? snapshot.tick - baseline->tick : 0);
+        auto& base = baseline ? *baseline : Empty();
+
+        out.Write(snapshot.slot, NET_SLOT_BITS);
+        out.Write(snapshot.screen, NET_SCREEN_BITS);
+        out.Write(snapshot.day, NET_DAY_BITS);
+        out.WriteVar(snapshot.parsnips);
+        out.WriteVar(snapshot.timeLeft);
+        out.Write(snapshot.held, NET_SPRITE_BITS);
+        out.WriteSigned(snapshot.inputAck - base.inputAck);
+        out.Write(snapshot.sounds, NET_SOUND_BITS);
+        out.WriteSigned(snapshot.cameraX - base.cameraX);
+        out.WriteSigned(snapshot.cameraY - base.cameraY);
+
+        // Tiles new to the view are compared to empty ones
+        auto& area = snapshot.area;
+        out.WriteSigned(area.x0 - base.area.x0);
+        out.WriteSigned(area.y0 - base.area.y0);
+        out.WriteSigned(area.x1 - base.area.x1);
+        out.WriteSigned(area.y1 - base.area.y1);
+        std::vector<std::pair<int, uint8_t>> tiles;
+        int index = 0;
+        for (int y = area.y0; y <= area.y1; y++)
+        {
+            for (int x = area.x0; x <= area.x1; x++, index++)
+            {
+                if (snapshot.tiles[index] != base.Tile(x, y))
+                {
+                    tiles.emplace_back(index, snapshot.tiles[index]);
+                }
+            }
+        }
+        out.WriteVar(tiles.size());
+        int last = -1;
+        for (auto [at, tile] : tiles)
+        {
+            out.WriteVar(at - last - 1);
+            out.Write(tile, NET_TILE_BITS);
+            last = at;
+        }
+
+        // Keys are written as gaps to the one before, both lists are in key order
+        std::vector<uint32_t> removed;
+        std::vector<std::pair<const NetSprite*, const NetSprite*>> changed;
+        size_t b = 0;
+        for (auto& sprite : snapshot.sprites)
+        {
+            while (b < base.sprites.size() && base.sprites[b].key < sprite.key)
+            {
+                removed.push_back(base.sprites[b++].key);
+            }
+            const NetSprite* before = nullptr;
+            if (b < base.sprites.size() && base.sprites[b].key == sprite.key)
+            {
+                before = &base.sprites[b++];
+            }
+            changed.emplace_back(&sprite, before);
+        }
+        for (; b < base.sprites.size(); b++)
+        {
+            removed.push_back(base.sprites[b].key);
+        }
+        out.WriteVar(removed.size());
+        uint32_t previous = 0;
+        for (auto key : removed)
+        {
+            out.WriteVar(key - previous);
+            previous = key;
+        }
+
+        static const NetSprite none;
+        auto mask = [](const NetSprite& a, const NetSprite& b)
+        {
+            return uint8_t((a.x != b.x || a.y != b.y ? CHANGED_POSITION : 0) |
+                           (a.w != b.w || a.h != b.h ? CHANGED_SIZE : 0) |
+                           (a.sprite != b.sprite ? CHANGED_SPRITE : 0) |
+                           (a.layer != b.layer ? CHANGED_LAYER : 0));
+        };
+        changed.erase(std::remove_if(changed.begin(), changed.end(), [&](auto& pair)
+        {
+            return pair.second && mask(*pair.first, *pair.second) == 0;
+        }), changed.end());
+        out.WriteVar(changed.size());
+        previous = 0;
+        for (auto [sprite, before] : changed)
+        {
+            auto& from = before ? *before : none;
+            auto fields = mask(*sprite, from);
+            out.WriteVar(sprite->key - previous);
+            previous = sprite->key;
+            out.Write(fields, 4);
+            if (fields & CHANGED_POSITION)
+            {
+                out.WriteSigned(sprite->x - from.x);
+                out.WriteSigned(sprite->y - from.y);
+            }
+            if (fields & CHANGED_SIZE)
+            {
+                out.WriteSigned(sprite->w);
+                out.WriteSigned(sprite->h);
+            }
+            if (fields & CHANGED_SPRITE)
+            {
+                out.Write(sprite->sprite, NET_SPRITE_BITS);
+            }
+            if (fields & CHANGED_LAYER)
+            {
+                out.Write(sprite->layer, NET_LAYER_BITS);
+            }
+        }
+        return out.Finish();
+    }
+
+    // The tick a packet holds and the one it is the difference to, 0 for none
+    inline bool PeekSnapshot(const std::vector<uint8_t>& packet, uint32_t& tick, uint32_t& baseline)
+    {
+        BitReader in(packet.data(), packet.size());
+        tick = in.Read(32);
+        auto distance = in.ReadVar();
+        baseline = distance ? tick - distance : 0;
+        return !in.Failed() && tick != 0;
+    }
+
+    // False for a damaged packet, baseline has to be the snapshot PeekSnapshot named
+    inline bool DecodeSnapshot(const std::vector<uint8_t>& packet, const Snapshot* baseline, Snapshot& out)
+    {
+        BitReader in(packet.data(), packet.size());
+        out.tick = in.Read(32);
+        in.ReadVar();
+        auto& base = baseline ? *baseline : Empty();
+
+        out.slot = in.Read(NET_SLOT_BITS);
+        out.screen = in.Read(NET_SCREEN_BITS);
+        out.day = in.Read(NET_DAY_BITS);
+        out.parsnips = in.ReadVar();
+        out.timeLeft = in.ReadVar();
+        out.held = in.Read(NET_SPRITE_BITS);
+        out.inputAck = base.inputAck + in.ReadSigned();
+        out.sounds = in.Read(NET_SOUND_BITS);
+        out.cameraX = base.cameraX + in.ReadSigned();
+        out.cameraY = base.cameraY + in.ReadSigned();
+
+        auto& area = out.area;
+        area.x0 = base.area.x0 + in.ReadSigned();
+        area.y0 = base.area.y0 + in.ReadSigned();
+        area.x1 = base.area.x1 + in.ReadSigned();
+        area.y1 = base.area.y1 + in.ReadSigned();
+        // A view is a screenful of tiles, anything much larger is damage
+        constexpr int MAX_SIDE = 1024;
+        if (in.Failed() || area.x1 - area.x0 < -1 || area.y1 - area.y0 < -1 || area.x1 - area.x0 >= MAX_SIDE || area.y1 - area.y0 >= MAX_SIDE)
+        {
+            return false;
+        }
+        out.tiles.clear();
+        for (int y = area.y0; y <= area.y1; y++)
+        {
+            for (int x = area.x0; x <= area.x1; x++)
+            {
+                out.tiles.push_back(base.Tile(x, y));
+            }
+        }
+        auto tiles = in.ReadVar();
+        int at = -1;
+        for (uint32_t i = 0; i < tiles && !in.Failed(); i++)
+        {
+            at += in.ReadVar() + 1;
+            auto tile = in.Read(NET_TILE_BITS);
+            if (at < 0 || (size_t) at >= out.tiles.size())
+            {
+                return false;
+            }
+            out.tiles[at] = tile;
+        }
+
+        auto removedCount = in.ReadVar();
+        if (removedCount > base.sprites.size())
+        {
+            return false;
+        }
+        std::vector<uint32_t> removed(removedCount);
+        uint32_t key = 0;
+        for (auto& gone : removed)
+        {
+            key += in.ReadVar();
+            gone = key;
+        }
+        out.sprites.clear();
+        size_t b = 0;
+        size_t r = 0;
+        // Base sprites that weren't removed up to key go out first
+        auto keep = [&](uint64_t until)
+        {
+            for (; b < base.sprites.size() && base.sprites[b].key < until; b++)
+            {
+                while (r < removed.size() && removed[r] < base.sprites[b].key)
+                {
+                    r++;
+                }
+                if (r >= removed.size() || removed[r] != base.sprites[b].key)
+                {
+                    out.sprites.push_back(base.sprites[b]);
+                }
+            }
+        };
+        auto changed = in.ReadVar();
+        key = 0;
+        for (uint32_t i = 0; i < changed && !in.Failed(); i++)
+        {
+            key += in.ReadVar();
+            keep(key);
+            NetSprite sprite;
+            sprite.key = key;
+            if (b < base.sprites.size() && base.sprites[b].key == key)
+            {
+                sprite = base.sprites[b++];
+            }
+            auto fields = in.Read(4);
+            if (fields & CHANGED_POSITION)
+            {
+                sprite.x += in.ReadSigned();
+                sprite.y += in.ReadSigned();
+            }
+            if (fields & CHANGED_SIZE)
+            {
+                sprite.w = in.ReadSigned();
+                sprite.h = in.ReadSigned();
+            }
+            if (fields & CHANGED_SPRITE)
+            {
+                sprite.sprite = in.Read(NET_SPRITE_BITS);
+            }
+            if (fields & CHANGED_LAYER)
+            {
+                sprite.layer = in.Read(NET_LAYER_BITS);
+            }
+            out.sprites.push_back(sprite);
+        }
+        keep(uint64_t(UINT32_MAX) + 1);
+        return !in.Failed();
+    }
+}
+
+// The host's side. Peers get a free slot the first time they are heard from and keep it until they go quiet,
+// each is sent its own view every tick as the difference to the newest snapshot it confirmed
+class ReplicaServer
+{
+public:
+    // Snapshots kept per client to diff against, a client that confirmed nothing newer gets everything again
+    static constexpr uint32_t HISTORY = 32;
+    // Clients silent for this many ticks have left
+    static constexpr uint32_t TIMEOUT = 5 * 60;
+
+    explicit ReplicaServer(std::unique_ptr<Transport> transport) : m_transport(std::move(transport))
+    {
+    }
+
+    void Receive(uint32_t tick)
+    {
+        int peer;
+        while (m_transport->Receive(peer, m_packet))
+        {
+            Input(peer, tick);
+        }
+        for (auto& client : m_clients)
+        {
+            if (client.connected && tick - client.lastHeard > TIMEOUT)
+            {
+                client = Client();
+            }
+        }
+    }
+
+    // Slot 0 is the host's own and never connected
+    bool Connected(int slot) const
+    {
+        return m_clients[slot].connected;
+    }
+
+    // The keys held in the newest input and everything pressed since the last call
+    ActionState TakeActions(int slot)
+    {
+        auto actions = m_clients[slot].actions;
+        m_clients[slot].actions.pressed = 0;
+        return actions;
+    }
+
+    tako::Vector2 View(int slot) const
+    {
+        return m_clients[slot].view;
+    }
+
+    // The snapshot to fill for the client on this tick, reusing what an old one allocated
+    Snapshot& Prepare(int slot, uint32_t tick)
+    {
+        auto& client = m_clients[slot];
+        auto& snapshot = client.history[tick % HISTORY];
+        snapshot.tick = tick;
+        snapshot.slot = slot;
+        snapshot.inputAck = client.inputSeq;
+        return snapshot;
+    }
+
+    void Send(int slot, uint32_t tick)
+    {
+        auto& client = m_clients[slot];
+        auto& snapshot = client.history[tick % HISTORY];
+        const Snapshot* baseline = nullptr;
+        if (client.ack && tick - client.ack < HISTORY && client.history[client.ack % HISTORY].tick == client.ack)
+        {
+            baseline = &client.history[client.ack % HISTORY];
+        }
+        auto packet = Replication::EncodeSnapshot(snapshot, baseline);
+        m_bytes += packet.size();
+        m_transport->Send(client.peer, std::move(packet));
+    }
+
+    // Bytes of every snapshot sent so far
+    uint64_t BytesSent() const
+    {
+        return m_bytes;
+    }
+private:
+    struct Client
+    {
+        bool connected = false;
+        int peer = -1;
+        uint32_t lastHeard = 0;
+        uint32_t inputSeq = 0;
+        // The newest snapshot it has, 0 for none
+        uint32_t ack = 0;
+        ActionState actions;
+        tako::Vector2 view = {0, 0};
+        std::array<Snapshot, HISTORY> history;
+    };
+
+    std::unique_ptr<Transport> m_transport;
+    std::array<Client, MAX_PLAYERS> m_clients;
+    std::vector<uint8_t> m_packet;
+    uint64_t m_bytes = 0;
+
+    // ack, sequence, held keys, view size, then the presses of the inputs before in turn starting with this one's
+    void Input(int peer, uint32_t tick)
+    {
+        BitReader in(m_packet.data(), m_packet.size());
+        auto ack = in.Read(32);
+        auto sequence = in.Read(32);
+        ActionBits held = in.Read(NET_ACTION_BITS);
+        float viewX = in.ReadVar();
+        float viewY = in.ReadVar();
+        auto presses = in.ReadVar();
+        if (in.Failed())
+        {
+            return;
+        }
+        Client* client = nullptr;
+        for (int slot = 1; slot < MAX_PLAYERS && !client; slot++)
+        {
+            if (m_clients[slot].connected && m_clients[slot].peer == peer)
+            {
+                client = &m_clients[slot];
+            }
+        }
+        for (int slot = 1; slot < MAX_PLAYERS && !client; slot++)
+        {
+            if (!m_clients[slot].connected)
+            {
+                client = &m_clients[slot];
+                client->connected = true;
+                client->peer = peer;
+            }
+        }
+        if (!client)
+        {
+            return;
+        }
+        client->lastHeard = tick;
+        if (ack > client->ack && ack <= tick)
+        {
+            client->ack = ack;
+        }
+        if (sequence <= client->inputSeq)
+        {
+            return;
+        }
+        for (uint32_t i = 0; i < presses && sequence - i > client->inputSeq; i++)
+        {
+            client->actions.pressed |= in.Read(NET_ACTION_BITS);
+        }
+        if (in.Failed())
+        {
+            return;
+        }
+        client->actions.held = held;
+        client->view = {viewX, viewY};
+        client->inputSeq = sequence;
+    }
+};
+
+// A client's side, it has no world of its own and only keeps the snapshots the host may diff against
+class ReplicaClient
+{
+public:
+    static constexpr uint32_t HISTORY = ReplicaServer::HISTORY;
+    // Presses the host hasn't confirmed go along with every input, this many frames back
+    static constexpr size_t RESEND = 16;
+
+    explicit ReplicaClient(std::unique_ptr<Transport> transport) : m_transport(std::move(transport))
+    {
+    }
+
+    void SendInput(const ActionState& actions, tako::Vector2 view)
+    {
+        m_sequence++;
+        m_presses.push_front(actions.pressed);
+        if (m_presses.size() > RESEND)
+        {
+            m_presses.pop_back();
+        }
+        BitWriter out;
+        out.Write(m_latest, 32);
+        out.Write(m_sequence, 32);
+        out.Write(actions.held, NET_ACTION_BITS);
+        out.WriteVar(std::max(0, (int) view.x));
+        out.WriteVar(std::max(0, (int) view.y));
+        auto unconfirmed = std::min<size_t>(m_presses.size(), m_sequence - Latest().inputAck);
+        out.WriteVar(unconfirmed);
+        for (size_t i = 0; i < unconfirmed; i++)
+        {
+            out.Write(m_presses[i], NET_ACTION_BITS);
+        }
+        m_transport->Send(0, out.Finish());
+    }
+
+    // Applies every snapshot that came, the sounds of each one are kept for TakeSounds
+    void Receive()
+    {
+        int peer;
+        while (m_transport->Receive(peer, m_packet))
+        {
+            uint32_t tick;
+            uint32_t baseline;
+            if (peer != 0 || !Replication::PeekSnapshot(m_packet, tick, baseline) || tick <= m_latest)
+            {
+                continue;
+            }
+            const Snapshot* base = nullptr;
+            if (baseline)
+            {
+                base = &m_history[baseline % HISTORY];
+                // Too old, the host diffs against a newer one once this client's confirmation arrives
+                if (base->tick != baseline || tick - baseline >= HISTORY)
+                {
+                    continue;
+                }
+            }
+            if (!Replication::DecodeSnapshot(m_packet, base, m_scratch))
+            {
+                continue;
+            }
+            std::swap(m_history[tick % HISTORY], m_scratch);
+            m_latest = tick;
+            m_sounds |= Latest().sounds;
+        }
+    }
+
+    // Whether anything came from the host yet
+    bool Connected() const
+    {
+        return m_latest != 0;
+    }
+
+    const Snapshot& Latest() const
+    {
+        return m_latest ? m_history[m_latest % HISTORY] : Replication::Empty();
+    }
+
+    uint32_t TakeSounds()
+    {
+        return std::exchange(m_sounds, 0);
+    }
+private:
+    std::unique_ptr<Transport> m_transport;
+    std::array<Snapshot, HISTORY> m_history;
+    Snapshot m_scratch;
+    uint32_t m_latest = 0;
+    uint32_t m_sequence = 0;
+    // Newest first
+    std::deque<ActionBits> m_presses;
+    uint32_t m_sounds = 0;
+    std::vector<uint8_t> m_packet;
+};
@@ -0,0 +1,377 @@
+#pragma once
+#include "Tako.hpp"
+#include "Graphics.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// Names a loaded resource without owning it. Once the resource is unloaded its slot's generation moves on
+// and old handles resolve to nothing, even after the slot is reused
+template<class T>
+struct Handle
+{
+    static constexpr uint32_t NONE = UINT32_MAX;
+    uint32_t index = NONE;
+    uint32_t generation = 0;
+
+    explicit operator bool() const
+    {
+        return index != NONE;
+    }
+};
+
+using TextureHandle = Handle<Gfx::Texture>;
+using ClipHandle = Handle<tako::AudioClip>;
+
+// Loads each file once however many users ask for it and counts them. Files nobody uses any more stay loaded
+// while they fit the budget, past it the least recently used of them are unloaded first. Resources in use
+// are never unloaded, so the budget can be exceeded by what is in use. Main thread only.
+class ResourceManager
+{
+public:
+    static constexpr size_t DEFAULT_BUDGET = 64 << 20;
+
+    explicit ResourceManager(Gfx::Drawer* drawer, size_t budget = DEFAULT_BUDGET) : m_drawer(drawer), m_budget(budget)
+    {
+    }
+
+    ~ResourceManager()
+    {
+        for (uint32_t i = 0; i < m_textures.slots.size(); i++)
+        {
+            Unload(m_textures, i);
+        }
+        for (uint32_t i = 0; i < m_clips.slots.size(); i++)
+        {
+            Unload(m_clips, i);
+        }
+    }
+
+    ResourceManager(const ResourceManager&) = delete;
+    ResourceManager& operator=(const ResourceManager&) = delete;
+
+    Gfx::Drawer* Drawer() const
+    {
+        return m_drawer;
+    }
+
+    // Every load is matched by a Release once the caller is done with it
+    TextureHandle LoadTexture(const char* file)
+    {
+        return Acquire(m_textures, file, [&](Slot<Gfx::Texture>& slot)
+        {
+            auto bitmap = tako::Bitmap::FromFile(file);
+            slot.width = bitmap.Width();
+            slot.height = bitmap.Height();
+            slot.bytes = size_t(bitmap.Width()) * bitmap.Height() * sizeof(tako::Color);
+            slot.resource = m_drawer->CreateTexture(bitmap);
+        });
+    }
+
+    // contents is what the file holds, read by the caller who usually needs it too. Tako decodes the clip
+    // on its own, the clip is charged what its samples take decoded
+    ClipHandle LoadClip(const char* file, const std::vector<tako::U8>& contents)
+    {
+        return Acquire(m_clips, file, [&](Slot<tako::AudioClip>& slot)
+        {
+            slot.bytes = DecodedSize(contents.data(), contents.size());
+            slot.resource = new tako::AudioClip(file);
+        });
+    }
+
+    // Reads the whole file in one go, false if it can't be read
+    static bool ReadFile(const char* file, std::vector<tako::U8>& contents)
+    {
+        contents.resize(tako::FileSystem::GetFileSize(file));
+        size_t read = 0;
+        if (!tako::FileSystem::ReadFile(file, contents.data(), contents.size(), read))
+        {
+            contents.clear();
+            return false;
+        }
+        contents.resize(read);
+        return true;
+    }
+
+    template<class T>
+    void Retain(Handle<T> handle)
+    {
+        if (auto slot = Find(PoolOf(handle), handle))
+        {
+            slot->users++;
+        }
+    }
+
+    template<class T>
+    void Release(Handle<T> handle)
+    {
+        auto slot = Find(PoolOf(handle), handle);
+        if (slot && --slot->users == 0)
+        {
+            Trim();
+        }
+    }
+
+    // Nothing for a handle whose resource was unloaded
+    template<class T>
+    T* Get(Handle<T> handle)
+    {
+        auto slot = Find(PoolOf(handle), handle);
+        if (!slot)
+        {
+            return nullptr;
+        }
+        slot->lastUse = ++m_clock;
+        return slot->resource;
+    }
+
+    tako::Vector2 Size(TextureHandle handle)
+    {
+        auto slot = Find(m_textures, handle);
+        return slot ? tako::Vector2(slot->width, slot->height) : tako::Vector2(0, 0);
+    }
+
+    void SetBudget(size_t bytes)
+    {
+        m_budget = bytes;
+        Trim();
+    }
+
+    size_t Budget() const
+    {
+        return m_budget;
+    }
+
+    // Bytes of everything loaded, in use or not
+    size_t Used() const
+    {
+        return m_used;
+    }
+private:
+    template<class T>
+    struct Slot
+    {
+        std::string file;
+        T* resource = nullptr;
+        size_t bytes = 0;
+        int width = 0;
+        int height = 0;
+        uint32_t generation = 0;
+        int users = 0;
+        uint64_t lastUse = 0;
+    };
+
+    template<class T>
+    struct Pool
+    {
+        std::vector<Slot<T>> slots;
+        std::vector<uint32_t> free;
+        std::unordered_map<std::string, uint32_t> byFile;
+    };
+
+    Gfx::Drawer* m_drawer;
+    Pool<Gfx::Texture> m_textures;
+    Pool<tako::AudioClip> m_clips;
+    size_t m_budget;
+    size_t m_used = 0;
+    uint64_t m_clock = 0;
+
+    Pool<Gfx::Texture>& PoolOf(TextureHandle)
+    {
+        return m_textures;
+    }
+
+    Pool<tako::AudioClip>& PoolOf(ClipHandle)
+    {
+        return m_clips;
+    }
+
+    template<class T>
+    static Slot<T>* Find(Pool<T>& pool, Handle<T> handle)
+    {
+        if (handle.index >= pool.slots.size())
+        {
+            return nullptr;
+        }
+        auto& slot = pool.slots[handle.index];
+        return slot.resource && slot.generation == handle.generation ? &slot : nullptr;
+    }
+
+    template<class T, class F>
+    Handle<T> Acquire(Pool<T>& pool, const char* file, F load)
+    {
+        auto found = pool.byFile.find(file);
+        if (found != pool.byFile.end())
+        {
+            auto& slot = pool.slots[found->second];
+            slot.users++;
+            slot.lastUse = ++m_clock;
+            return {found->second, slot.generation};
+        }
+
+        uint32_t index;
+        if (!pool.free.empty())
+        {
+            index = pool.free.back();
+            pool.free.pop_back();
+        }
+        else
+        {
+            index = pool.slots.size();
+            pool.slots.emplace_back();
+        }
+        auto& slot = pool.slots[index];
+        load(slot);
+        slot.file = file;
+        slot.users = 1;
+        slot.lastUse = ++m_clock;
+        pool.byFile[slot.file] = index;
+        m_used += slot.bytes;
+        Trim();
+        return {index, slot.generation};
+    }
+
+    template<class T>
+    void Unload(Pool<T>& pool, uint32_t index)
+    {
+        auto& slot = pool.slots[index];
+        if (!slot.resource)
+        {
+            return;
+        }
+        if constexpr (std::is_same_v<T, Gfx::Texture>)
+        {
+            Gfx::DestroyTexture(m_drawer, slot.resource);
+        }
+        else
+        {
+            delete slot.resource;
+        }
+        m_used -= slot.bytes;
+        pool.byFile.erase(slot.file);
+        auto generation = slot.generation + 1;
+        slot = {};
+        slot.generation = generation;
+        pool.free.push_back(index);
+    }
+
+    // The least recently used resource nobody uses, of either kind
+    template<class T>
+    static void Oldest(Pool<T>& pool, uint64_t& lastUse, int& found)
+    {
+        for (uint32_t i = 0; i < pool.slots.size(); i++)
+        {
+            auto& slot = pool.slots[i];
+            if (slot.resource && slot.users <= 0 && (found < 0 || slot.lastUse < lastUse))
+            {
+                lastUse = slot.lastUse;
+                found = i;
+            }
+        }
+    }
+
+    void Trim()
+    {
+        while (m_used > m_budget)
+        {
+            uint64_t textureUse = 0;
+            int texture = -1;
+            if (Gfx::CAN_DESTROY_TEXTURES)
+            {
+                Oldest(m_textures, textureUse, texture);
+            }
+            uint64_t clipUse = 0;
+            int clip = -1;
+            Oldest(m_clips, clipUse, clip);
+            if (texture < 0 && clip < 0)
+            {
+                return;
+            }
+            if (clip < 0 || (texture >= 0 && textureUse < clipUse))
+            {
+                Unload(m_textures, texture);
+            }
+            else
+            {
+                Unload(m_clips, clip);
+            }
+        }
+    }
+
+    // Bytes of the clip's samples as floats, from the header of a wav or the frame headers of an mp3.
+    // Anything else is charged its size
+    static size_t DecodedSize(const tako::U8* data, size_t size)
+    {
+        auto u16 = [&](size_t at) { return uint16_t(data[at] | data[at + 1] << 8); };
+        auto u32 = [&](size_t at) { return uint32_t(u16(at) | u16(at + 2) << 16); };
+        if (size >= 12 && !std::memcmp(data, "RIFF", 4) && !std::memcmp(data + 8, "WAVE", 4))
+        {
+            size_t channels = 0;
+            size_t bits = 0;
+            for (size_t at = 12; at + 8 <= size;)
+            {
+                size_t chunkSize = std::min<size_t>(u32(at + 4), size - at - 8);
+                if (!std::memcmp(data + at, "fmt ", 4) && chunkSize >= 16)
+                {
+                    channels = u16(at + 10);
+                    bits = u16(at + 22);
+                }
+                else if (!std::memcmp(data + at, "data", 4) && channels > 0 && bits >= 8)
+                {
+                    return chunkSize / (bits / 8) * sizeof(float);
+                }
+                at += 8 + chunkSize + (chunkSize & 1);
+            }
+            return size;
+        }
+
+        // An ID3 tag goes first, its size is 7 bits per byte
+        size_t at = 0;
+        if (size >= 10 && !std::memcmp(data, "ID3", 3))
+        {
+            at = 10 + (size_t(data[6] & 0x7F) << 21 | (data[7] & 0x7F) << 14 | (data[8] & 0x7F) << 7 | (data[9] & 0x7F));
+        }
+        static constexpr uint16_t BITRATES[2][3][15] =
+        {
+            {
+                {0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448},
+                {0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384},
+                {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320}
+            },
+            {
+                {0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256},
+                {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160},
+                {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160}
+            }
+        };
+        static constexpr uint32_t RATES[3] = {44100, 48000, 32000};
+        size_t samples = 0;
+        // Frames are counted until the first thing that isn't one, like a tag at the end
+        while (at + 4 <= size && data[at] == 0xFF && (data[at + 1] & 0xE0) == 0xE0)
+        {
+            int version = (data[at + 1] >> 3) & 3;
+            int layer = 3 - ((data[at + 1] >> 1) & 3);
+            int bitrateIndex = data[at + 2] >> 4;
+            int rateIndex = (data[at + 2] >> 2) & 3;
+            if (version == 1 || layer == 3 || bitrateIndex == 0 || bitrateIndex == 15 || rateIndex == 3)
+            {
+                break;
+            }
+            // Versions 2 and 2.5 halve and quarter the rate, layer 3 then has half the samples per frame
+            bool mpeg1 = version == 3;
+            size_t bitrate = BITRATES[mpeg1 ? 0 : 1][layer][bitrateIndex] * 1000;
+            size_t rate = RATES[rateIndex] >> (mpeg1 ? 0 : version == 2 ? 1 : 2);
+            size_t padding = (data[at + 2] >> 1) & 1;
+            size_t frameSamples = layer == 0 ? 384 : layer == 2 && !mpeg1 ? 576 : 1152;
+            size_t channels = (data[at + 3] >> 6) == 3 ? 1 : 2;
+            size_t length = layer == 0 ? (12 * bitrate / rate + padding) * 4 : frameSamples / 8 * bitrate / rate + padding;
+            samples += frameSamples * channels;
+            at += length;
+        }
+        return samples > 0 ? samples * sizeof(float) : size;
+    }
+};
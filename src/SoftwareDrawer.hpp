@@ -0,0 +1,297 @@
+#pragma once
+#include "Tako.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <vector>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SOFTWARE_DRAWER_SSE2
+#endif
+
+// The drawer calls the game makes, rasterised on the CPU into the target size so frames can be made
+// without a GPU. Coordinates work like PixelArtDrawer: y points up, a draw's x/y is its top left corner
+// and the camera position is the center of the view. A negative width mirrors the image.
+class SoftwareDrawer
+{
+public:
+    struct Texture
+    {
+        int width;
+        int height;
+        std::vector<uint32_t> pixels;
+    };
+
+    struct Sprite
+    {
+        Texture* texture;
+        int x;
+        int y;
+        int width;
+        int height;
+    };
+
+    SoftwareDrawer()
+    {
+        SetTargetSize(240, 135);
+    }
+
+    void SetTargetSize(int width, int height)
+    {
+        m_width = width;
+        m_height = height;
+        m_frame.assign(width * height, Pack({0, 0, 0, 255}));
+    }
+
+    // There is no window to fit
+    void AutoScale() {}
+
+    Texture* CreateTexture(const tako::Bitmap& bitmap)
+    {
+        m_textures.push_back(std::make_unique<Texture>());
+        auto texture = m_textures.back().get();
+        UpdateTexture(texture, bitmap);
+        return texture;
+    }
+
+    void UpdateTexture(Texture* texture, const tako::Bitmap& bitmap)
+    {
+        texture->width = bitmap.Width();
+        texture->height = bitmap.Height();
+        texture->pixels.resize(texture->width * texture->height);
+        auto data = bitmap.GetData();
+        for (size_t i = 0; i < texture->pixels.size(); i++)
+        {
+            texture->pixels[i] = Pack(data[i]);
+        }
+    }
+
+    // Sprites cut from the texture go with it
+    void DestroyTexture(Texture* texture)
+    {
+        m_sprites.erase(std::remove_if(m_sprites.begin(), m_sprites.end(), [&](const std::unique_ptr<Sprite>& sprite)
+        {
+            return sprite->texture == texture;
+        }), m_sprites.end());
+        m_textures.erase(std::remove_if(m_textures.begin(), m_textures.end(), [&](const std::unique_ptr<Texture>& owned)
+        {
+            return owned.get() == texture;
+        }), m_textures.end());
+    }
+
+    Sprite* CreateSprite(Texture* texture, float x, float y, float width, float height)
+    {
+        m_sprites.push_back(std::make_unique<Sprite>(Sprite{texture, (int) x, (int) y, (int) width, (int) height}));
+        return m_sprites.back().get();
+    }
+
+    void Clear()
+    {
+        std::fill(m_frame.begin(), m_frame.end(), Pack({0, 0, 0, 255}));
+    }
+
+    void SetCameraPosition(tako::Vector2 position)
+    {
+        m_camera = position;
+    }
+
+    tako::Vector2 GetCameraViewSize()
+    {
+        return tako::Vector2(m_width, m_height);
+    }
+
+    void DrawSprite(float x, float y, float w, float h, Sprite* sprite, tako::Color color = {255, 255, 255, 255})
+    {
+        Blit(x, y, w, h, *sprite->texture, sprite->x, sprite->y, sprite->width, sprite->height, color);
+    }
+
+    void DrawImage(float x, float y, float w, float h, Texture* texture, tako::Color color = {255, 255, 255, 255})
+    {
+        Blit(x, y, w, h, *texture, 0, 0, texture->width, texture->height, color);
+    }
+
+    void DrawRectangle(float x, float y, float w, float h, tako::Color color)
+    {
+        Span span;
+        if (!Clip(x, y, w, h, span))
+        {
+            return;
+        }
+        m_row.assign(span.x1 - span.x0, Pack(color));
+        for (int py = span.y0; py < span.y1; py++)
+        {
+            BlendRow(&m_frame[py * m_width + span.x0], m_row.data(), span.x1 - span.x0, {255, 255, 255, 255});
+        }
+    }
+
+    // RGBA, top row first
+    const std::vector<uint32_t>& Pixels() const
+    {
+        return m_frame;
+    }
+
+    // Binary PPM, any image tool opens it
+    bool SaveFrame(const char* file) const
+    {
+        auto out = std::fopen(file, "wb");
+        if (!out)
+        {
+            return false;
+        }
+        std::fprintf(out, "P6\n%d %d\n255\n", m_width, m_height);
+        std::vector<uint8_t> rgb(m_frame.size() * 3);
+        for (size_t i = 0; i < m_frame.size(); i++)
+        {
+            rgb[i * 3] = m_frame[i] & 0xFF;
+            rgb[i * 3 + 1] = (m_frame[i] >> 8) & 0xFF;
+            rgb[i * 3 + 2] = (m_frame[i] >> 16) & 0xFF;
+        }
+        std::fwrite(rgb.data(), 1, rgb.size(), out);
+        std::fclose(out);
+        return true;
+    }
+private:
+    // Target pixels covered by a draw, x1 and y1 exclusive
+    struct Span
+    {
+        int x0;
+        int y0;
+        int x1;
+        int y1;
+        int left;
+        int top;
+        int width;
+        int height;
+    };
+
+    int m_width;
+    int m_height;
+    tako::Vector2 m_camera = {0, 0};
+    std::vector<uint32_t> m_frame;
+    std::vector<uint32_t> m_row;
+    std::vector<int> m_columns;
+    std::vector<std::unique_ptr<Texture>> m_textures;
+    std::vector<std::unique_ptr<Sprite>> m_sprites;
+
+    static uint32_t Pack(tako::Color color)
+    {
+        return uint32_t(color.r) | uint32_t(color.g) << 8 | uint32_t(color.b) << 16 | uint32_t(color.a) << 24;
+    }
+
+    bool Clip(float x, float y, float w, float h, Span& span)
+    {
+        // Mirrored draws extend left of x
+        float left = std::min(x, x + w) - (m_camera.x - m_width / 2.0f);
+        float top = (m_camera.y + m_height / 2.0f) - y;
+        span.left = (int) std::floor(left + 0.5f);
+        span.top = (int) std::floor(top + 0.5f);
+        span.width = (int) std::abs(w);
+        span.height = (int) h;
+        span.x0 = std::max(0, span.left);
+        span.y0 = std::max(0, span.top);
+        span.x1 = std::min(m_width, span.left + span.width);
+        span.y1 = std::min(m_height, span.top + span.height);
+        return span.x0 < span.x1 && span.y0 < span.y1;
+    }
+
+    void Blit(float x, float y, float w, float h, const Texture& texture, int srcX, int srcY, int srcW, int srcH, tako::Color color)
+    {
+        Span span;
+        bool inside = srcX >= 0 && srcY >= 0 && srcW > 0 && srcH > 0 && srcX + srcW <= texture.width && srcY + srcH <= texture.height;
+        if (!inside || !Clip(x, y, w, h, span))
+        {
+            return;
+        }
+        int count = span.x1 - span.x0;
+        bool flip = w < 0;
+        // Nearest texel for every covered column, a 1:1 unmirrored draw reads the texture rows directly
+        bool direct = !flip && span.width == srcW;
+        if (!direct)
+        {
+            m_columns.resize(count);
+            m_row.resize(count);
+            for (int i = 0; i < count; i++)
+            {
+                int column = (span.x0 + i - span.left) * srcW / span.width;
+                m_columns[i] = srcX + (flip ? srcW - 1 - column : column);
+            }
+        }
+        for (int py = span.y0; py < span.y1; py++)
+        {
+            int sy = srcY + (py - span.top) * srcH / span.height;
+            const uint32_t* source = &texture.pixels[sy * texture.width];
+            if (direct)
+            {
+                source += srcX + span.x0 - span.left;
+            }
+            else
+            {
+                for (int i = 0; i < count; i++)
+                {
+                    m_row[i] = source[m_columns[i]];
+                }
+                source = m_row.data();
+            }
+            BlendRow(&m_frame[py * m_width + span.x0], source, count, color);
+        }
+    }
+
+    // Exact v / 255 rounded, for v up to 255 * 255
+    static uint32_t Div255(uint32_t v)
+    {
+        v += 128;
+        return (v + (v >> 8)) >> 8;
+    }
+
+#ifdef SOFTWARE_DRAWER_SSE2
+    static __m128i Div255(__m128i v)
+    {
+        v = _mm_add_epi16(v, _mm_set1_epi16(128));
+        return _mm_srli_epi16(_mm_add_epi16(v, _mm_srli_epi16(v, 8)), 8);
+    }
+#endif
+
+    // dst = src * tint over dst, by the tinted alpha. The target stays opaque.
+    static void BlendRow(uint32_t* dst, const uint32_t* src, int count, tako::Color tint)
+    {
+        int i = 0;
+#ifdef SOFTWARE_DRAWER_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i full = _mm_set1_epi16(255);
+        const __m128i opaque = _mm_set1_epi32((int) 0xFF000000);
+        const __m128i tint16 = _mm_setr_epi16(tint.r, tint.g, tint.b, tint.a, tint.r, tint.g, tint.b, tint.a);
+        // Two pixels at a time, one 16 bit lane per channel
+        auto blend = [&](__m128i s, __m128i d)
+        {
+            s = Div255(_mm_mullo_epi16(s, tint16));
+            __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, 0xFF), 0xFF);
+            return Div255(_mm_add_epi16(_mm_mullo_epi16(s, a), _mm_mullo_epi16(d, _mm_sub_epi16(full, a))));
+        };
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+            __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+            __m128i lo = blend(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero));
+            __m128i hi = blend(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_or_si128(_mm_packus_epi16(lo, hi), opaque));
+        }
+#endif
+        for (; i < count; i++)
+        {
+            uint32_t s = src[i];
+            uint32_t d = dst[i];
+            uint32_t a = Div255((s >> 24) * tint.a);
+            uint32_t out = 0xFF000000;
+            const uint8_t channels[3] = {tint.r, tint.g, tint.b};
+            for (int c = 0; c < 3; c++)
+            {
+                uint32_t sc = Div255(((s >> (c * 8)) & 0xFF) * channels[c]);
+                uint32_t dc = (d >> (c * 8)) & 0xFF;
+                out |= Div255(sc * a + dc * (255 - a)) << (c * 8);
+            }
+            dst[i] = out;
+        }
+    }
+};
@@ -0,0 +1,208 @@
+#pragma once
+#include "Events.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// One gameplay event as stored in the stream, written in native byte order
+struct TelemetryRecord
+{
+    uint32_t frame;
+    // Seconds into the day
+    float clock;
+    int32_t value;
+    uint16_t day;
+    uint8_t type;
+    uint8_t flags;
+};
+static_assert(sizeof(TelemetryRecord) == 16);
+
+// Record type after the event types, value is how many records were lost to a full buffer
+constexpr uint8_t TELEMETRY_DROPPED = 0xFF;
+constexpr uint8_t TELEMETRY_AUDIBLE = 1;
+constexpr char TELEMETRY_MAGIC[8] = {'L', 'D', '4', '7', 'T', 'L', 'M', '1'};
+
+inline const char* EventName(uint8_t type)
+{
+    constexpr std::array<const char*, (size_t) EventType::Count> names =
+    {{
+        "pickup", "drop", "harvest", "deliver", "sow", "water", "fill", "error", "day-passed", "day-rewound", "clock"
+    }};
+    if (type == TELEMETRY_DROPPED)
+    {
+        return "dropped";
+    }
+    return type < names.size() ? names[type] : "unknown";
+}
+
+// Writes gameplay events to a binary file on a background thread. Recording is a slot claim in a bounded
+// lock-free ring, any thread may record and nothing blocks or allocates; events are dropped and counted
+// when the flusher falls behind. Does nothing until opened, and web builds have no thread to flush with.
+class Telemetry
+{
+public:
+    static constexpr size_t CAPACITY = 1 << 14;
+
+    ~Telemetry()
+    {
+        Close();
+    }
+
+    bool Open(const char* file)
+    {
+#ifdef __EMSCRIPTEN__
+        return false;
+#else
+        Close();
+        m_file = std::fopen(file, "wb");
+        if (!m_file)
+        {
+            return false;
+        }
+        std::fwrite(TELEMETRY_MAGIC, 1, sizeof(TELEMETRY_MAGIC), m_file);
+        m_slots = std::make_unique<Slot[]>(CAPACITY);
+        for (size_t i = 0; i < CAPACITY; i++)
+        {
+            m_slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        m_head.store(0, std::memory_order_relaxed);
+        m_tail = 0;
+        m_dropped.store(0, std::memory_order_relaxed);
+        m_droppedWritten = 0;
+        m_quit = false;
+        m_open.store(true, std::memory_order_release);
+        m_flusher = std::thread([this] { Flush(); });
+        return true;
+#endif
+    }
+
+    // Writes out everything recorded so far
+    void Close()
+    {
+        if (!m_open.exchange(false))
+        {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_quit = true;
+        }
+        m_wake.notify_one();
+        m_flusher.join();
+        std::fclose(m_file);
+        m_file = nullptr;
+    }
+
+    bool IsOpen() const
+    {
+        return m_open.load(std::memory_order_relaxed);
+    }
+
+    void Record(EventType type, bool audible, int value, int day, float clock, uint32_t frame)
+    {
+        if (!IsOpen())
+        {
+            return;
+        }
+        size_t pos = m_head.load(std::memory_order_relaxed);
+        Slot* slot;
+        while (true)
+        {
+            slot = &m_slots[pos & (CAPACITY - 1)];
+            auto diff = (intptr_t) slot->sequence.load(std::memory_order_acquire) - (intptr_t) pos;
+            if (diff == 0 && m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                break;
+            }
+            if (diff < 0)
+            {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            if (diff > 0)
+            {
+                pos = m_head.load(std::memory_order_relaxed);
+            }
+        }
+        slot->record = {frame, clock, value, (uint16_t) day, (uint8_t) type, uint8_t(audible ? TELEMETRY_AUDIBLE : 0)};
+        slot->sequence.store(pos + 1, std::memory_order_release);
+    }
+
+    uint64_t Dropped() const
+    {
+        return m_dropped.load(std::memory_order_relaxed);
+    }
+private:
+    // sequence == position when free for that position, position + 1 once its record is written
+    struct Slot
+    {
+        std::atomic<size_t> sequence;
+        TelemetryRecord record;
+    };
+
+    std::unique_ptr<Slot[]> m_slots;
+    alignas(64) std::atomic<size_t> m_head = 0;
+    alignas(64) size_t m_tail = 0;
+    std::atomic<uint64_t> m_dropped = 0;
+    uint64_t m_droppedWritten = 0;
+    std::atomic<bool> m_open = false;
+    std::FILE* m_file = nullptr;
+    std::thread m_flusher;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_quit = false;
+
+    // Takes the records that are written in order, stops at the first claimed one still being written
+    size_t Drain(std::vector<TelemetryRecord>& out)
+    {
+        size_t count = 0;
+        while (true)
+        {
+            Slot& slot = m_slots[m_tail & (CAPACITY - 1)];
+            if (slot.sequence.load(std::memory_order_acquire) != m_tail + 1)
+            {
+                return count;
+            }
+            out.push_back(slot.record);
+            slot.sequence.store(m_tail + CAPACITY, std::memory_order_release);
+            m_tail++;
+            count++;
+        }
+    }
+
+    void Flush()
+    {
+        std::vector<TelemetryRecord> batch;
+        batch.reserve(CAPACITY);
+        bool quit = false;
+        while (!quit)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_wake.wait_for(lock, std::chrono::milliseconds(5), [&] { return m_quit; });
+                quit = m_quit;
+            }
+            batch.clear();
+            Drain(batch);
+            auto dropped = m_dropped.load(std::memory_order_relaxed);
+            if (dropped != m_droppedWritten)
+            {
+                TelemetryRecord lost = {};
+                lost.type = TELEMETRY_DROPPED;
+                lost.value = (int32_t) (dropped - m_droppedWritten);
+                batch.push_back(lost);
+                m_droppedWritten = dropped;
+            }
+            std::fwrite(batch.data(), sizeof(TelemetryRecord), batch.size(), m_file);
+        }
+        std::fflush(m_file);
+    }
+};
@@ -0,0 +1,62 @@
+#include "Telemetry.hpp"
+#include <cstdio>
+#include <cstring>
+#include <map>
+
+// Prints a telemetry stream as one line per event followed by totals.
+// Usage: ld47-telemetry <file> [--summary]
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::fprintf(stderr, "usage: %s <file> [--summary]\n", argv[0]);
+        return 1;
+    }
+    bool summary = argc > 2 && std::strcmp(argv[2], "--summary") == 0;
+    auto in = std::fopen(argv[1], "rb");
+    if (!in)
+    {
+        std::fprintf(stderr, "could not open %s\n", argv[1]);
+        return 1;
+    }
+    char magic[sizeof(TELEMETRY_MAGIC)];
+    if (std::fread(magic, 1, sizeof(magic), in) != sizeof(magic) || std::memcmp(magic, TELEMETRY_MAGIC, sizeof(magic)) != 0)
+    {
+        std::fprintf(stderr, "%s is not a telemetry stream\n", argv[1]);
+        std::fclose(in);
+        return 1;
+    }
+
+    std::map<uint8_t, long> totals;
+    long dropped = 0;
+    TelemetryRecord record;
+    if (!summary)
+    {
+        std::printf("frame\tday\tclock\tevent\taudible\tvalue\n");
+    }
+    while (std::fread(&record, sizeof(record), 1, in) == 1)
+    {
+        if (record.type == TELEMETRY_DROPPED)
+        {
+            dropped += record.value;
+            continue;
+        }
+        totals[record.type]++;
+        if (!summary)
+        {
+            std::printf("%u\t%u\t%.2f\t%s\t%d\t%d\n", record.frame, record.day, record.clock, EventName(record.type),
+                        record.flags & TELEMETRY_AUDIBLE, record.value);
+        }
+    }
+    std::fclose(in);
+
+    for (auto [type, count] : totals)
+    {
+        std::printf("# %s %ld\n", EventName(type), count);
+    }
+    if (dropped > 0)
+    {
+        std::printf("# dropped %ld\n", dropped);
+    }
+    return 0;
+}
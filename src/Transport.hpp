@@ -0,0 +1,106 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Unreliable datagrams between a host and its peers, packets may be lost, duplicated or come out of order.
+// Peers are numbered by the transport, a client knows the host as peer 0
+class Transport
+{
+public:
+    virtual ~Transport() = default;
+
+    virtual void Send(int peer, std::vector<uint8_t> packet) = 0;
+
+    // False once nothing is waiting
+    virtual bool Receive(int& peer, std::vector<uint8_t>& packet) = 0;
+};
+
+// Endpoints in one process handing packets over through memory, with optional loss to exercise what
+// a real network does. Any endpoint can be used from its own thread
+class LoopbackNetwork : public std::enable_shared_from_this<LoopbackNetwork>
+{
+public:
+    // Every nth packet is dropped, 0 for none
+    explicit LoopbackNetwork(int dropEvery = 0) : m_dropEvery(dropEvery)
+    {
+    }
+
+    // Endpoint 0 is the host
+    std::unique_ptr<Transport> Endpoint(int id)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_inboxes.size() <= (size_t) id)
+        {
+            m_inboxes.resize(id + 1);
+        }
+        return std::make_unique<Loopback>(shared_from_this(), id);
+    }
+
+    // Bytes sent by every endpoint so far, dropped packets included
+    uint64_t BytesSent() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_bytes;
+    }
+private:
+    struct Packet
+    {
+        int from;
+        std::vector<uint8_t> data;
+    };
+
+    class Loopback : public Transport
+    {
+    public:
+        Loopback(std::shared_ptr<LoopbackNetwork> network, int id) : m_network(std::move(network)), m_id(id)
+        {
+        }
+
+        void Send(int peer, std::vector<uint8_t> packet) override
+        {
+            m_network->Deliver(m_id, peer, std::move(packet));
+        }
+
+        bool Receive(int& peer, std::vector<uint8_t>& packet) override
+        {
+            return m_network->Take(m_id, peer, packet);
+        }
+    private:
+        std::shared_ptr<LoopbackNetwork> m_network;
+        int m_id;
+    };
+
+    mutable std::mutex m_mutex;
+    std::vector<std::deque<Packet>> m_inboxes;
+    int m_dropEvery;
+    uint64_t m_sent = 0;
+    uint64_t m_bytes = 0;
+
+    void Deliver(int from, int to, std::vector<uint8_t> packet)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_bytes += packet.size();
+        if (to < 0 || (size_t) to >= m_inboxes.size() || (m_dropEvery > 0 && ++m_sent % m_dropEvery == 0))
+        {
+            return;
+        }
+        m_inboxes[to].push_back({from, std::move(packet)});
+    }
+
+    bool Take(int id, int& peer, std::vector<uint8_t>& packet)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto& inbox = m_inboxes[id];
+        if (inbox.empty())
+        {
+            return false;
+        }
+        peer = inbox.front().from;
+        packet = std::move(inbox.front().data);
+        inbox.pop_front();
+        return true;
+    }
+};
@@ -0,0 +1,39 @@
+#pragma once
+#include <array>
+#include <atomic>
+
+// One writer and one reader passing whole values without waiting on each other. The writer fills the back
+// buffer and publishes it, the reader takes the newest published one, values published in between are skipped.
+template<class T>
+class TripleBuffer
+{
+public:
+    // Only for the writer, reused so its allocations stay
+    T& Back()
+    {
+        return m_buffers[m_back];
+    }
+
+    void Publish()
+    {
+        m_back = m_ready.exchange(m_back | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    // Only for the reader, the newest published value or the one it had before when nothing new came
+    const T& Front()
+    {
+        if (m_ready.load(std::memory_order_relaxed) & FRESH)
+        {
+            m_front = m_ready.exchange(m_front, std::memory_order_acq_rel) & INDEX;
+        }
+        return m_buffers[m_front];
+    }
+private:
+    static constexpr int INDEX = 3;
+    static constexpr int FRESH = 4;
+
+    std::array<T, 3> m_buffers;
+    int m_back = 0;
+    int m_front = 1;
+    std::atomic<int> m_ready = 2;
+};
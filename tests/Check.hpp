@@ -0,0 +1,22 @@
+#pragma once
+#include <cmath>
+#include <cstdio>
+
+// Failed checks are printed and counted, a test returns Failures() so ctest sees them
+inline int& Failures()
+{
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            Failures()++; \
+        } \
+    } while (false)
+
+#define CHECK_NEAR(a, b, tolerance) CHECK(std::abs((a) - (b)) <= (tolerance))
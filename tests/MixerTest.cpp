@@ -0,0 +1,169 @@
+#include "Check.hpp"
+#include "Mixer.hpp"
+#include <vector>
+
+// A sound holding one value in both channels
+static Sound Constant(float value, size_t frames)
+{
+    Sound sound;
+    sound.samples.assign(frames * MIX_CHANNELS, value);
+    return sound;
+}
+
+static std::vector<float> Render(Mixer& mixer, size_t frames)
+{
+    std::vector<float> out(frames * MIX_CHANNELS);
+    mixer.Render(out.data(), frames);
+    return out;
+}
+
+static void InstanceLimit()
+{
+    auto sound = Constant(0.25f, 10000);
+    Mixer mixer;
+    SoundRule rule = {1, 2, 1};
+    auto first = mixer.Play(&sound, rule);
+    auto second = mixer.Play(&sound, rule);
+    auto third = mixer.Play(&sound, rule);
+    CHECK(mixer.Active() == 2);
+    CHECK(!mixer.Playing(first));
+    CHECK(mixer.Playing(second));
+    CHECK(mixer.Playing(third));
+
+    // The oldest instance fades out while the new one starts at full volume
+    auto out = Render(mixer, Mixer::DECLICK * 2);
+    CHECK_NEAR(out[0], 0.75f, 1e-4f);
+    CHECK_NEAR(out[Mixer::DECLICK * MIX_CHANNELS], 0.5f, 1e-4f);
+}
+
+static void Stealing()
+{
+    auto low = Constant(0.1f, 10000);
+    auto high = Constant(0.1f, 10000);
+    auto lowest = Constant(0.1f, 10000);
+    Mixer mixer;
+    std::vector<VoiceHandle> voices;
+    for (int i = 0; i < Mixer::VOICES; i++)
+    {
+        voices.push_back(mixer.Play(&low, {1, Mixer::VOICES, 1}));
+    }
+    CHECK(mixer.Active() == Mixer::VOICES);
+    CHECK(!mixer.Play(&lowest, {0, 1, 1}));
+
+    // The oldest voice of the lowest priority goes first
+    CHECK(mixer.Play(&high, {2, 1, 1}));
+    CHECK(!mixer.Playing(voices[0]));
+    CHECK(mixer.Playing(voices[1]));
+    CHECK(mixer.Active() == Mixer::VOICES);
+}
+
+static void Ramps()
+{
+    auto sound = Constant(1.0f, 20000);
+    Mixer mixer;
+    auto voice = mixer.Play(&sound, {1, 1, 0.5f}, false, 1000 / (float) MIX_RATE);
+    auto out = Render(mixer, 2000);
+    CHECK_NEAR(out[0], 0.0f, 1e-4f);
+    CHECK_NEAR(out[500 * MIX_CHANNELS], 0.25f, 1e-3f);
+    CHECK_NEAR(out[500 * MIX_CHANNELS + 1], 0.25f, 1e-3f);
+    CHECK_NEAR(out[1999 * MIX_CHANNELS], 0.5f, 1e-4f);
+
+    // Odd spans make the vector loop hand over to the scalar tail mid ramp
+    mixer.Ramp(voice, 1.0f, 1001 / (float) MIX_RATE);
+    out = Render(mixer, 3);
+    CHECK_NEAR(out[2 * MIX_CHANNELS], 0.5f + 2 * 0.5f / 1001, 1e-4f);
+
+    mixer.Stop(voice);
+    out = Render(mixer, Mixer::DECLICK + 10);
+    CHECK(out[0] > 0);
+    CHECK_NEAR(out[(Mixer::DECLICK + 5) * MIX_CHANNELS], 0.0f, 1e-6f);
+    CHECK(!mixer.Playing(voice));
+    CHECK(mixer.Active() == 0);
+}
+
+static void Ending()
+{
+    auto sound = Constant(0.5f, 100);
+    Mixer mixer;
+    auto once = mixer.Play(&sound, {1, 2, 1});
+    auto looped = mixer.Play(&sound, {1, 2, 1}, true);
+    auto out = Render(mixer, 150);
+    CHECK_NEAR(out[99 * MIX_CHANNELS], 1.0f, 1e-4f);
+    CHECK_NEAR(out[120 * MIX_CHANNELS], 0.5f, 1e-4f);
+    CHECK(!mixer.Playing(once));
+    CHECK(mixer.Playing(looped));
+
+    // Advance keeps the same time without making samples
+    mixer.Stop(looped);
+    mixer.Advance(1.0f);
+    CHECK(mixer.Active() == 0);
+}
+
+static void Elsewhere()
+{
+    auto sound = Constant(0.5f, MIX_RATE);
+    auto other = Constant(0.5f, MIX_RATE);
+    Mixer mixer;
+    mixer.PlayElsewhere(true);
+    CHECK(mixer.Play(&sound, {3, 1, 1}));
+    CHECK(!mixer.Play(&sound, {3, 1, 1}));
+    for (int i = 1; i < Mixer::VOICES; i++)
+    {
+        CHECK(mixer.Play(&other, {0, Mixer::VOICES, 1}));
+    }
+    CHECK(!mixer.Play(&sound, {9, 2, 1}));
+
+    // What already sounds can't be cut short, voices come free as their sounds end
+    auto voice = mixer.Play(&other, {0, Mixer::VOICES, 1});
+    CHECK(!voice);
+    mixer.Advance(0.5f);
+    CHECK(mixer.Active() == Mixer::VOICES);
+    mixer.Advance(0.6f);
+    CHECK(mixer.Active() == 0);
+}
+
+static void Conversion()
+{
+    std::vector<float> in = {2, -2, 0.5f, -0.5f, 1, -1, 0, 3e9f, -3e9f, 0.25f, 1.5f};
+    std::vector<int16_t> out(in.size());
+    Mixer::ToPcm16(in.data(), out.data(), in.size());
+    std::vector<int16_t> expected = {32767, -32767, 16384, -16384, 32767, -32767, 0, 32767, -32767, 8192, 32767};
+    CHECK(out == expected);
+}
+
+static void Decoding()
+{
+    // 16 bit mono at half the mix rate, a ramp from 0 to 3 / 8
+    std::vector<uint8_t> wav =
+    {
+        'R', 'I', 'F', 'F', 44, 0, 0, 0, 'W', 'A', 'V', 'E',
+        'f', 'm', 't', ' ', 16, 0, 0, 0, 1, 0, 1, 0, 0x22, 0x56, 0, 0, 0x44, 0xAC, 0, 0, 2, 0, 16, 0,
+        'd', 'a', 't', 'a', 8, 0, 0, 0, 0, 0, 0, 0x10, 0, 0x20, 0, 0x30
+    };
+    auto sound = Sound::FromWav(wav.data(), wav.size());
+    CHECK(sound.has_value());
+    if (!sound)
+    {
+        return;
+    }
+    CHECK(sound->Frames() == 7);
+    CHECK_NEAR(sound->samples[0], 0.0f, 1e-6f);
+    CHECK_NEAR(sound->samples[1], 0.0f, 1e-6f);
+    CHECK_NEAR(sound->samples[2 * MIX_CHANNELS], 0.125f, 1e-6f);
+    CHECK_NEAR(sound->samples[5 * MIX_CHANNELS + 1], 0.3125f, 1e-6f);
+
+    wav[20] = 2;
+    CHECK(!Sound::FromWav(wav.data(), wav.size()));
+}
+
+int main()
+{
+    InstanceLimit();
+    Stealing();
+    Ramps();
+    Ending();
+    Elsewhere();
+    Conversion();
+    Decoding();
+    return Failures();
+}
@@ -0,0 +1,240 @@
+#include "Check.hpp"
+#include "Replication.hpp"
+#include "Transport.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <random>
+#include <vector>
+
+static std::mt19937 s_random(47);
+
+static int Between(int low, int high)
+{
+    return std::uniform_int_distribution<int>(low, high)(s_random);
+}
+
+static NetSprite MakeSprite(uint32_t key)
+{
+    NetSprite sprite;
+    sprite.key = key;
+    sprite.x = Between(-100000, 100000);
+    sprite.y = Between(0, 100000);
+    sprite.w = Between(-16, 16);
+    sprite.h = 24;
+    sprite.sprite = Between(0, (1 << NET_SPRITE_BITS) - 1);
+    sprite.layer = Between(0, (1 << NET_LAYER_BITS) - 1);
+    return sprite;
+}
+
+// The next tick of what a client sees: the view wanders or jumps, some tiles change, sprites come, go and move
+static void Advance(const Snapshot& previous, Snapshot& next)
+{
+    next.screen = Between(0, (1 << NET_SCREEN_BITS) - 1);
+    next.day = Between(0, (1 << NET_DAY_BITS) - 1);
+    next.parsnips = previous.parsnips + Between(0, 2);
+    next.timeLeft = Between(0, 960);
+    next.held = Between(0, 3);
+    next.sounds = Between(0, 3);
+    next.cameraX = previous.cameraX + Between(-50, 50);
+    next.cameraY = previous.cameraY + Between(-50, 50);
+    auto area = previous.area;
+    if (previous.tiles.empty() || Between(0, 9) == 0)
+    {
+        int x = Between(0, 5000);
+        int y = Between(0, 5000);
+        area = {x, y, x + Between(0, 20), y + Between(0, 12)};
+    }
+    else
+    {
+        int dx = Between(-2, 2);
+        int dy = Between(-2, 2);
+        area = {area.x0 + dx, area.y0 + dy, area.x1 + dx, area.y1 + dy};
+    }
+    next.area = area;
+    next.tiles.clear();
+    for (int y = area.y0; y <= area.y1; y++)
+    {
+        for (int x = area.x0; x <= area.x1; x++)
+        {
+            next.tiles.push_back(Between(0, 9) ? previous.Tile(x, y) : Between(0, (1 << NET_TILE_BITS) - 1));
+        }
+    }
+    next.sprites.clear();
+    for (auto sprite : previous.sprites)
+    {
+        if (Between(0, 9) == 0)
+        {
+            continue;
+        }
+        if (Between(0, 2) == 0)
+        {
+            sprite.x += Between(-9, 9);
+            sprite.y += Between(-9, 9);
+        }
+        if (Between(0, 20) == 0)
+        {
+            sprite.sprite = Between(0, (1 << NET_SPRITE_BITS) - 1);
+        }
+        next.sprites.push_back(sprite);
+    }
+    for (int i = Between(0, 3); i > 0; i--)
+    {
+        auto key = Between(0, 3) == 0 ? UINT32_MAX - Between(0, 2) : (uint32_t) Between(0, 400);
+        bool taken = false;
+        for (auto& sprite : next.sprites)
+        {
+            taken |= sprite.key == key;
+        }
+        if (!taken)
+        {
+            next.sprites.push_back(MakeSprite(key));
+        }
+    }
+    std::sort(next.sprites.begin(), next.sprites.end(), [](auto& a, auto& b) { return a.key < b.key; });
+}
+
+static bool Same(const Snapshot& a, const Snapshot& b)
+{
+    if (a.tick != b.tick || a.slot != b.slot || a.screen != b.screen || a.day != b.day || a.parsnips != b.parsnips ||
+        a.timeLeft != b.timeLeft || a.held != b.held || a.inputAck != b.inputAck || a.sounds != b.sounds ||
+        a.cameraX != b.cameraX || a.cameraY != b.cameraY)
+    {
+        return false;
+    }
+    if (a.area.x0 != b.area.x0 || a.area.y0 != b.area.y0 || a.area.x1 != b.area.x1 || a.area.y1 != b.area.y1 ||
+        a.tiles != b.tiles || a.sprites.size() != b.sprites.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < a.sprites.size(); i++)
+    {
+        auto& x = a.sprites[i];
+        auto& y = b.sprites[i];
+        if (x.key != y.key || x.x != y.x || x.y != y.y || x.w != y.w || x.h != y.h || x.sprite != y.sprite ||
+            x.layer != y.layer)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Every tick is encoded against one of the ticks before it and must come back as it was
+static void DeltaRoundTrip()
+{
+    std::vector<Snapshot> history(1);
+    size_t fullBytes = 0;
+    size_t deltaBytes = 0;
+    for (uint32_t tick = 1; tick < 2000; tick++)
+    {
+        Snapshot snapshot;
+        Advance(history.back(), snapshot);
+        snapshot.tick = tick;
+        snapshot.slot = 1;
+        snapshot.inputAck = tick / 2;
+        const Snapshot* baseline = nullptr;
+        if (history.size() > 1 && Between(0, 5))
+        {
+            baseline = &history[history.size() - 1 - Between(0, std::min<int>(history.size() - 2, 10))];
+        }
+
+        auto packet = Replication::EncodeSnapshot(snapshot, baseline);
+        uint32_t peekTick;
+        uint32_t peekBaseline;
+        CHECK(Replication::PeekSnapshot(packet, peekTick, peekBaseline));
+        CHECK(peekTick == tick);
+        CHECK(peekBaseline == (baseline ? baseline->tick : 0));
+        Snapshot decoded;
+        CHECK(Replication::DecodeSnapshot(packet, baseline, decoded));
+        CHECK(Same(snapshot, decoded));
+
+        if (baseline == &history[history.size() - 1])
+        {
+            fullBytes += Replication::EncodeSnapshot(snapshot, nullptr).size();
+            deltaBytes += packet.size();
+        }
+        // Cut short it must be refused rather than read past its end
+        packet.resize(Between(0, packet.size() - 1));
+        Snapshot junk;
+        CHECK(!Replication::DecodeSnapshot(packet, baseline, junk));
+
+        history.push_back(std::move(snapshot));
+        if (history.size() > 40)
+        {
+            history.erase(history.begin() + 1);
+        }
+    }
+    CHECK(deltaBytes > 0 && deltaBytes < fullBytes);
+}
+
+// A host and a client over a network losing every dropEvery-th packet. Whatever snapshot the client ends up with
+// must be the one the host made for that tick, and once the network calms down it catches up with the host
+static void Loopback(int dropEvery)
+{
+    auto network = std::make_shared<LoopbackNetwork>(dropEvery);
+    ReplicaServer server(network->Endpoint(0));
+    ReplicaClient client(network->Endpoint(1));
+    std::map<uint32_t, Snapshot> sent;
+    Snapshot previous;
+    int checked = 0;
+    uint32_t skipped = 0;
+    uint32_t lastSeen = 0;
+    constexpr uint32_t TICKS = 600;
+    for (uint32_t tick = 1; tick <= TICKS + ReplicaServer::HISTORY; tick++)
+    {
+        client.SendInput({}, {320, 240});
+        server.Receive(tick);
+        if (!server.Connected(1))
+        {
+            continue;
+        }
+        auto& snapshot = server.Prepare(1, tick);
+        // Past TICKS nothing changes, the client gets there by diffing against what it has
+        if (tick <= TICKS)
+        {
+            Advance(previous, snapshot);
+            previous = snapshot;
+        }
+        else
+        {
+            auto prepared = snapshot;
+            snapshot = previous;
+            snapshot.tick = prepared.tick;
+            snapshot.slot = prepared.slot;
+            snapshot.inputAck = prepared.inputAck;
+        }
+        sent[tick] = snapshot;
+        server.Send(1, tick);
+
+        client.Receive();
+        auto& latest = client.Latest();
+        if (latest.tick != lastSeen)
+        {
+            skipped += latest.tick - lastSeen - 1;
+            lastSeen = latest.tick;
+            CHECK(sent.count(latest.tick) && Same(latest, sent[latest.tick]));
+            checked++;
+        }
+    }
+    CHECK(checked > (int) TICKS / 2);
+    CHECK(client.Latest().tick > TICKS);
+    CHECK(network->BytesSent() > server.BytesSent());
+    if (dropEvery > 0)
+    {
+        CHECK(skipped > 0);
+    }
+    else
+    {
+        CHECK(skipped == 0);
+    }
+}
+
+int main()
+{
+    DeltaRoundTrip();
+    Loopback(0);
+    Loopback(3);
+    Loopback(7);
+    return Failures();
+}
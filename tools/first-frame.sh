@@ -0,0 +1,21 @@
+#!/bin/sh
+# Time from navigation to the first drawn frame of the web build, in headless Chrome.
+# Usage: tools/first-frame.sh <build dir> [runs] [port]
+set -e
+BUILD_DIR=${1:?build dir with index.html}
+RUNS=${2:-5}
+PORT=${3:-8047}
+CHROME=${CHROME:-$(command -v chromium || command -v chromium-browser || command -v google-chrome)}
+
+python3 -m http.server "$PORT" --directory "$BUILD_DIR" >/dev/null 2>&1 &
+SERVER=$!
+trap 'kill $SERVER' EXIT
+sleep 1
+
+for i in $(seq "$RUNS"); do
+    PROFILE=$(mktemp -d)
+    timeout 30 "$CHROME" --headless=new --disable-gpu-sandbox --use-angle=swiftshader --autoplay-policy=no-user-gesture-required \
+        --user-data-dir="$PROFILE" --enable-logging=stderr --v=0 "http://localhost:$PORT/index.html" 2>&1 \
+        | grep -m1 -o 'first frame [0-9.]* ms' || echo "no frame"
+    rm -rf "$PROFILE"
+done